@@ -0,0 +1,178 @@
+#include "analyze.hpp"
+#include "core/searchworker.hpp"
+#include "primitives/utility.hpp"
+#include "cli.hpp"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+/*
+ * FILE: analyze.cpp
+ * An EPD line is the first four FEN fields followed by ';'-terminated
+ * operations, e.g.
+ * 2rr3k/pp3pp1/1nnqbN1p/3pN3/2pP4/2P3Q1/PPB4P/R4RK1 w - - bm Qg6; id "WAC.001";
+ * Positions are claimed through an atomic index, so a worker that
+ * drew quick positions takes over the rest of the queue.
+ * */
+
+namespace {
+
+struct EpdEntry {
+    Board board;
+    std::string id;
+    std::vector<Move> best, avoid;
+    Move result{};
+    uint64_t nodes{};
+};
+
+bool solved(const EpdEntry &e) {
+    auto contains = [&](const std::vector<Move> &v) {
+        return std::find(v.begin(), v.end(), e.result) != v.end();
+    };
+    if (!e.best.empty() && !contains(e.best))
+        return false;
+    return !contains(e.avoid);
+}
+
+//false with the reason in error if the line cannot be scored
+bool parse_epd(const std::string &line, EpdEntry &e, std::string &error) {
+    std::istringstream is(line);
+    std::string fen, token;
+    for (int i = 0; i < 4 && is >> token; ++i)
+        fen += token + ' ';
+    if (!e.board.load_fen(fen)) {
+        error = "bad fen";
+        return false;
+    }
+
+    std::string op;
+    while (std::getline(is >> std::ws, op, ';')) {
+        std::istringstream ops(op);
+        std::string code;
+        ops >> code;
+        if (code == "bm" || code == "am") {
+            auto &moves = code == "bm" ? e.best : e.avoid;
+            while (ops >> token) {
+                const Move m = move_from_san(e.board, token);
+                if (m == MOVE_NONE) {
+                    error = "cannot parse " + code + " move " + token;
+                    return false;
+                }
+                moves.push_back(m);
+            }
+        } else if (code == "id") {
+            std::getline(ops >> std::ws, e.id);
+            e.id.erase(std::remove(e.id.begin(), e.id.end(), '"'), e.id.end());
+        }
+    }
+
+    //without an expectation any move would count as solved
+    if (e.best.empty() && e.avoid.empty()) {
+        error = "no bm or am move";
+        return false;
+    }
+    return true;
+}
+
+std::vector<EpdEntry> load_suite(const std::string &epd) {
+    std::vector<EpdEntry> suite;
+    std::ifstream in(epd);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty())
+            continue;
+        EpdEntry e{};
+        if (std::string error; parse_epd(line, e, error))
+            suite.push_back(std::move(e));
+        else
+            sync_cout() << "info string analyze: " << error << ", skipped " << line << '\n';
+    }
+    return suite;
+}
+
+void print_moves(std::ostream &os, const std::vector<Move> &moves) {
+    for (const Move m: moves)
+        os << ' ' << m;
+}
+
+} //namespace
+
+void analyze(const std::string &epd, const SearchLimits &limits, int threads) {
+    auto suite = load_suite(epd);
+    if (suite.empty()) {
+        sync_cout() << "info string analyze: no positions in " << epd << '\n';
+        return;
+    }
+
+    threads = std::clamp(threads, 1, static_cast<int>(suite.size()));
+    std::vector<std::unique_ptr<SearchWorker>> workers;
+    for (int i = 0; i < threads; ++i)
+        workers.push_back(std::make_unique<SearchWorker>());
+
+    const TimePoint start = timer::now();
+    std::atomic<size_t> next{};
+    auto work = [&](SearchWorker &worker) {
+        for (size_t i; (i = next.fetch_add(1)) < suite.size(); ) {
+            EpdEntry &e = suite[i];
+            worker.new_game();
+
+            Stack st;
+            st.reset();
+
+            SearchLimits lim = limits;
+            lim.silent = true;
+            lim.start = timer::now();
+
+            worker.go(e.board, st, lim);
+            worker.wait_for_completion();
+
+            e.result = worker.best_move();
+            if (!worker.iterations().empty())
+                e.nodes = worker.iterations().back().nodes;
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; ++i)
+        pool.emplace_back(work, std::ref(*workers[i]));
+    work(*workers[0]);
+    for (auto &t: pool)
+        t.join();
+
+    const TimePoint elapsed = timer::now() - start;
+    std::ostringstream ss;
+    int num_solved = 0;
+    uint64_t nodes = 0;
+    for (size_t i = 0; i < suite.size(); ++i) {
+        const EpdEntry &e = suite[i];
+        nodes += e.nodes;
+        if (solved(e)) {
+            ++num_solved;
+            continue;
+        }
+
+        ss << "failed " << (e.id.empty() ? std::to_string(i + 1) : e.id);
+        if (!e.best.empty()) {
+            ss << " bm";
+            print_moves(ss, e.best);
+        }
+        if (!e.avoid.empty()) {
+            ss << " am";
+            print_moves(ss, e.avoid);
+        }
+        ss << " got " << e.result << '\n';
+    }
+
+    ss << "\nPositions: " << suite.size()
+       << "\nSolved: " << num_solved
+       << "\nFailed: " << suite.size() - num_solved
+       << "\nNodes searched: " << nodes
+       << "\nTime (ms): " << elapsed
+       << "\nNodes/second: " << nodes * 1000 / (elapsed + 1) << '\n';
+
+    sync_cout() << ss.str();
+}
@@ -0,0 +1,15 @@
+#ifndef ANALYZE_HPP
+#define ANALYZE_HPP
+
+#include <string>
+#include "core/search_common.hpp"
+
+/*
+ * Runs a test suite: every EPD position ("bm"/"am" operations in SAN)
+ * is searched with the given limits by one of `threads` independent
+ * workers, which share only the transposition table.
+ * Prints the failed positions, the solved count, nodes and time.
+ * */
+void analyze(const std::string &epd, const SearchLimits &limits, int threads);
+
+#endif
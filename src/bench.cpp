@@ -0,0 +1,315 @@
+#include "bench.hpp"
+#include "core/searchworker.hpp"
+#include "cli.hpp"
+#include "tt.hpp"
+#include "movepicker.hpp"
+#include "core/eval.hpp"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+constexpr std::string_view BENCH_FENS[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP2BPPP/R2QKB1R w KQ - 0 8",
+    "2r2rk1/1bqnbpp1/1p1ppn1p/pP6/N1P1P3/P2B1N1P/1B2QPP1/R2R2K1 b - - 0 1",
+    "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+    "6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/3N4 b - - 0 1",
+    "8/k7/3p4/p2P1p2/P2P1P2/8/8/K7 w - - 0 1",
+    "8/8/4kpp1/3p1b2/p6P/2B5/6P1/6K1 b - - 0 47",
+};
+
+constexpr std::string_view ORDERING_FENS[] = {
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "1k6/3q4/8/3Q4/2Q1Q3/3Q4/8/4K3 w - - 0 1",
+    "R6R/3Q4/1Q4Q1/4Q3/2Q4Q/Q4Q2/pp1Q4/kBNN1KB1 w - - 0 1",
+};
+
+struct DepthTotals {
+    int positions{};
+    uint64_t nodes{};
+    uint64_t fail_high{}, fail_high_first{};
+    TimePoint time{};
+};
+
+std::vector<std::string> load_positions(const std::string &epd) {
+    std::vector<std::string> fens;
+    if (epd.empty()) {
+        for (auto fen: BENCH_FENS)
+            fens.emplace_back(fen);
+        return fens;
+    }
+
+    std::ifstream in(epd);
+    std::string line;
+    while (std::getline(in, line))
+        if (!line.empty())
+            fens.push_back(line);
+    return fens;
+}
+
+} //namespace
+
+void bench(SearchWorker &worker, int depth, const std::string &epd) {
+    depth = std::clamp(depth, 1, MAX_DEPTH - 1);
+    const auto fens = load_positions(epd);
+    std::vector<DepthTotals> totals(depth + 1);
+    uint64_t total_nodes = 0;
+    TimePoint total_time = 0;
+
+    for (const auto &fen: fens) {
+        Board b{};
+        if (!b.load_fen(fen)) {
+            sync_cout() << "info string bench: bad fen " << fen << '\n';
+            continue;
+        }
+
+        g_tt.clear();
+        worker.new_game();
+
+        Stack st;
+        st.reset();
+
+        SearchLimits limits;
+        limits.max_depth = depth;
+        limits.infinite = true;
+        limits.silent = true;
+        limits.start = timer::now();
+
+        worker.go(b, st, limits);
+        worker.wait_for_completion();
+
+        //counters are cumulative, turn them into per-iteration deltas
+        IterationStats prev{};
+        for (const auto &it: worker.iterations()) {
+            auto &t = totals[it.depth];
+            t.positions++;
+            t.nodes += it.nodes - prev.nodes;
+            t.fail_high += it.fail_high - prev.fail_high;
+            t.fail_high_first += it.fail_high_first - prev.fail_high_first;
+            t.time += it.time;
+            prev = it;
+        }
+
+        total_nodes += prev.nodes;
+        total_time += prev.time;
+    }
+
+    std::ostringstream ss;
+    ss << std::setw(5) << "depth" << std::setw(6) << "pos"
+       << std::setw(14) << "nodes" << std::setw(8) << "ebf"
+       << std::setw(8) << "fhf" << std::setw(10) << "time" << '\n';
+
+    ss << std::fixed;
+    for (int d = 1; d <= depth; ++d) {
+        const auto &t = totals[d], &p = totals[d - 1];
+        if (!t.positions)
+            break;
+
+        ss << std::setw(5) << d << std::setw(6) << t.positions
+           << std::setw(14) << t.nodes << std::setw(8) << std::setprecision(2);
+        if (p.nodes)
+            ss << static_cast<double>(t.nodes) / p.nodes;
+        else
+            ss << '-';
+        ss << std::setw(8) << std::setprecision(3)
+           << t.fail_high_first / static_cast<double>(t.fail_high + 1)
+           << std::setw(10) << t.time << '\n';
+    }
+
+    ss << "\nPositions: " << fens.size()
+       << "\nNodes searched: " << total_nodes
+       << "\nTime (ms): " << total_time
+       << "\nNodes/second: " << total_nodes * 1000 / (total_time + 1) << '\n';
+
+    sync_cout() << ss.str();
+}
+
+void bench_ordering(const int picks) {
+    constexpr int ITERATIONS = 20000;
+
+    auto hist = std::make_unique<Histories>();
+    std::mt19937 rng(12345);
+    std::uniform_int_distribution<int> dist(-16384, 16384);
+    auto *entries = reinterpret_cast<int16_t*>(hist.get());
+    for (size_t i = 0; i < sizeof(Histories) / sizeof(int16_t); ++i)
+        entries[i] = static_cast<int16_t>(dist(rng));
+
+    const PieceToHistory *conts[2] = { 
+        &hist->cont[W_KNIGHT][SQ_F3], &hist->cont[B_PAWN][SQ_E5] 
+    };
+
+    //ns per picker, so that nothing is optimised away
+    uint64_t checksum = 0;
+    auto run = [&](const Board &b, const int limit) {
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < ITERATIONS; ++i) {
+            MovePicker mp(b, MOVE_NONE, nullptr, hist.get(), 
+                    MOVE_NONE, MOVE_NONE, conts);
+            int n = 0;
+            for (Move m = mp.next<false>(); m != MOVE_NONE && n < limit;
+                    m = mp.next<false>(), ++n)
+                checksum += m;
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        return std::chrono::duration<double, std::nano>(elapsed).count() 
+            / ITERATIONS;
+    };
+
+    std::ostringstream ss;
+    ss << std::setw(6) << "moves" << std::setw(16) << "ns/first " + std::to_string(picks)
+       << std::setw(12) << "ns/all" << '\n';
+
+    ss << std::fixed << std::setprecision(0);
+    for (auto fen: ORDERING_FENS) {
+        Board b{};
+        if (!b.load_fen(fen))
+            continue;
+
+        ExtMove moves[MAX_MOVES];
+        ss << std::setw(6) << generate<LEGAL>(b, moves) - moves
+           << std::setw(16) << run(b, picks)
+           << std::setw(12) << run(b, MAX_MOVES) << '\n';
+    }
+
+    ss << "checksum " << checksum << '\n';
+    sync_cout() << ss.str();
+}
+
+void bench_eval() {
+    constexpr int ITERATIONS = 500;
+
+    std::vector<std::vector<Board>> nodes;
+    size_t total = 0;
+    for (auto fen: BENCH_FENS) {
+        Board b{};
+        if (!b.load_fen(fen))
+            continue;
+
+        ExtMove moves[MAX_MOVES];
+        std::vector<Board> children;
+        for (ExtMove *m = moves, *end = generate<LEGAL>(b, moves); m != end; ++m)
+            children.push_back(b.do_move(*m));
+        total += children.size();
+        nodes.push_back(std::move(children));
+    }
+
+    //ns per position, both checksums are the same
+    int16_t scores[MAX_MOVES];
+    auto run = [&](const bool batch, int64_t &checksum) {
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < ITERATIONS; ++i) {
+            for (const auto &children: nodes) {
+                if (batch)
+                    evaluate_batch(children.data(), children.size(), scores);
+                else
+                    for (size_t k = 0; k < children.size(); ++k)
+                        scores[k] = evaluate(children[k]);
+                for (size_t k = 0; k < children.size(); ++k)
+                    checksum += scores[k];
+            }
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        return std::chrono::duration<double, std::nano>(elapsed).count()
+            / (static_cast<double>(total) * ITERATIONS);
+    };
+
+    int64_t single_sum = 0, batch_sum = 0;
+    const double single = run(false, single_sum);
+    const double batch = run(true, batch_sum);
+
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(0)
+       << "Positions: " << total
+       << "\nSingle (ns/eval): " << single
+       << "\nBatch (ns/eval): " << batch
+       << "\nChecksum: " << single_sum << ' ' << batch_sum << '\n';
+    sync_cout() << ss.str();
+}
+
+void bench_latency(const int hash_mb) {
+    constexpr int REPS = 5, HOT = 64, PREFETCH_AHEAD = 8;
+    constexpr size_t PROBES = 1 << 20;
+
+    //positions two plies after the bench positions, all distinct
+    std::vector<Board> cold;
+    for (auto fen: BENCH_FENS) {
+        Board b{};
+        if (!b.load_fen(fen))
+            continue;
+
+        ExtMove moves[MAX_MOVES], replies[MAX_MOVES];
+        for (ExtMove *m = moves, *end = generate<LEGAL>(b, moves); m != end; ++m) {
+            const Board child = b.do_move(*m);
+            for (ExtMove *r = replies, *rend = generate<LEGAL>(child, replies); 
+                    r != rend; ++r)
+                cold.push_back(child.do_move(*r));
+        }
+    }
+    //as many evaluations of HOT positions spread over the set, so that
+    //both sets have the same mix of material
+    std::vector<Board> hot;
+    for (size_t i = 0; i < cold.size(); ++i)
+        hot.push_back(cold[i % HOT * (cold.size() / HOT)]);
+
+    //best of REPS runs, ns per call
+    int64_t checksum = 0;
+    auto time_it = [&](const size_t n, auto &&f) {
+        double best = 1e18;
+        for (int rep = 0; rep < REPS; ++rep) {
+            const auto start = std::chrono::steady_clock::now();
+            f();
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, std::chrono::duration<double, std::nano>(elapsed).count()
+                / static_cast<double>(n));
+        }
+        return best;
+    };
+    auto eval_all = [&](const std::vector<Board> &pos) {
+        return time_it(pos.size(), [&] {
+            for (const Board &b: pos)
+                checksum += evaluate(b);
+        });
+    };
+
+    TranspositionTable tt;
+    tt.resize(std::max(hash_mb, 1));
+    std::mt19937_64 rng(12345);
+    std::vector<uint64_t> keys(PROBES), hot_keys(PROBES);
+    for (size_t i = 0; i < PROBES; ++i) {
+        keys[i] = rng();
+        hot_keys[i] = keys[i % HOT];
+    }
+    auto probe_all = [&](const std::vector<uint64_t> &k, const int ahead) {
+        return time_it(k.size(), [&] {
+            TTEntry e{};
+            for (size_t i = 0; i < k.size(); ++i) {
+                if (ahead && i + ahead < k.size())
+                    tt.prefetch(k[i + ahead]);
+                checksum += tt.probe(k[i], e);
+            }
+        });
+    };
+
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(0)
+       << "Positions: " << cold.size()
+       << "\nEval cold (ns): " << eval_all(cold)
+       << "\nEval hot (ns): " << eval_all(hot)
+       << std::setprecision(1)
+       << "\nTT (MB): " << std::max(hash_mb, 1)
+       << "\nProbe cold (ns): " << probe_all(keys, 0)
+       << "\nProbe hot (ns): " << probe_all(hot_keys, 0)
+       << "\nProbe prefetched (ns): " << probe_all(keys, PREFETCH_AHEAD)
+       << "\nChecksum: " << checksum << '\n';
+    sync_cout() << ss.str();
+}
@@ -0,0 +1,39 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <string>
+
+class SearchWorker;
+
+/*
+ * Searches every position of the set to a fixed depth from
+ * a clean state and prints per-depth nodes, EBF, fail-high-first
+ * rate and time-to-depth. Uses the built-in position set
+ * unless an EPD file is given.
+ * */
+void bench(SearchWorker &worker, int depth, const std::string &epd = "");
+
+/*
+ * Time per MovePicker (generation, scoring and selection) with
+ * random histories, when a node takes the first `picks` moves
+ * and when it takes them all. Positions have 30-218 moves.
+ * */
+void bench_ordering(int picks = 3);
+
+/*
+ * Time per static evaluation of the positions after each legal
+ * move from the bench positions, one at a time and as one
+ * evaluate_batch() per node.
+ * */
+void bench_eval();
+
+/*
+ * What memory latency there is to hide: evaluate() on the 8610 distinct
+ * positions two plies after the bench positions against as many calls
+ * on 64 of them (cold and hot weight columns), and TT probes of random
+ * keys into a `hash_mb` table, of 64 keys, and of random keys with the
+ * bucket prefetched 8 probes ahead.
+ * */
+void bench_latency(int hash_mb = 256);
+
+#endif
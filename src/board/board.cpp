@@ -1,5 +1,6 @@
 #include "board.hpp"
 #include <ostream>
+#include <sstream>
 #include "../zobrist.hpp"
 #include "../movgen/attack.hpp"
 #include "../primitives/utility.hpp"
@@ -11,17 +12,6 @@
  * as some methods not worth creating a separate file
  * */
 
-constexpr uint64_t PCKEY_INDEX[COLOR_NB][PIECE_TYPE_NB] = {
-    { 0, 1ull << 0, 1ull << 4, 1ull << 8, 1ull << 12, 1ull << 16, 0 },
-    { 0, 1ull << 20, 1ull << 24, 1ull << 28,  1ull << 32, 1ull << 36, 0 },
-};
-
-template<Piece p, Piece ...pcs>
-constexpr uint64_t pckey_v = pckey_v<p> | pckey_v<pcs...>;
-
-template<Piece p>
-constexpr uint64_t pckey_v<p> = PCKEY_INDEX[static_cast<int>(color_of(p))][type_of(p)];
-
 Board Board::start_pos() {
     Board board{};
     const bool b = board.load_fen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
@@ -166,6 +156,7 @@ Bitboard Board::pieces(const Color c, const PieceType pt1, const PieceType pt2)
 { return color_combined_[c] & (pieces_[pt1] | pieces_[pt2]); }
 
 Piece Board::piece_on(const Square s) const { return pieces_on_[s]; }
+const Piece *Board::mailbox() const { return pieces_on_; }
 
 Bitboard Board::checkers() const { return checkers_; }
 Bitboard Board::blockers_for_king(const Color c) const { return blockers_for_king_[c]; }
@@ -188,6 +179,41 @@ namespace {
     };
 }
 
+std::string Board::fen() const {
+    std::ostringstream ss;
+    for (int r = RANK_8; r >= RANK_1; --r) {
+        int empty = 0;
+        for (int f = FILE_A; f <= FILE_H; ++f) {
+            const Piece p = piece_on(make_square(static_cast<File>(f), static_cast<Rank>(r)));
+            if (p == NO_PIECE) {
+                ++empty;
+                continue;
+            }
+            if (empty)
+                ss << empty;
+            empty = 0;
+            ss << PIECE_CHAR[p];
+        }
+        if (empty)
+            ss << empty;
+        if (r != RANK_1)
+            ss << '/';
+    }
+
+    ss << (side_to_move_ == WHITE ? " w " : " b ");
+    if (castling_ == NO_CASTLING)
+        ss << '-';
+    else
+        ss << castling_;
+    ss << ' ';
+    if (en_passant_ == SQ_NONE)
+        ss << '-';
+    else
+        ss << en_passant_;
+    ss << ' ' << static_cast<int>(half_moves_) << " 1";
+    return ss.str();
+}
+
 std::ostream& operator<<(std::ostream& os, const Board &b) {
     os << "+---+---+---+---+---+---+---+---+\n";
     for (int r = RANK_8; r >= RANK_1; --r) {
@@ -3,9 +3,13 @@
 
 #include "../primitives/common.hpp"
 #include "../primitives/bitboard.hpp"
+#include <string>
 #include <string_view>
 #include <iosfwd>
 
+struct ExtMove;
+struct PackedBoard;
+
 class Board {
 public:
     Board() = default;
@@ -13,6 +17,10 @@ public:
     static Board start_pos();
 
     bool load_fen(std::string_view fen);
+    //packed.hpp, false if pb is not a valid position
+    bool load_packed(const PackedBoard &pb);
+    //the move counters are "<half moves> 1"
+    [[nodiscard]] std::string fen() const;
 
     /*
      * Check that the board contains valid information
@@ -31,6 +39,9 @@ public:
     [[nodiscard]] bool is_valid_move(Move m) const;
 
     [[nodiscard]] bool see_ge(Move m, int threshold = 0) const;
+    //Writes the full SEE value of every move into its value,
+    //computing the attackers of each target square once
+    void see_all(ExtMove *begin, ExtMove *end) const;
 
     [[nodiscard]] bool is_quiet(Move m) const;
 
@@ -60,6 +71,8 @@ public:
     [[nodiscard]] Bitboard pieces(Color c, PieceType pt1, PieceType pt2) const;
 
     [[nodiscard]] Piece piece_on(Square s) const;
+    //[SQUARE_NB], for vectorised lookups
+    [[nodiscard]] const Piece *mailbox() const;
 
     [[nodiscard]] Bitboard checkers() const;
     [[nodiscard]] Bitboard blockers_for_king(Color c) const;
@@ -99,4 +112,16 @@ private:
 
 std::ostream& operator<<(std::ostream& os, const Board &b);
 
+//mat_key() is the sum of these over all the pieces, 4 bits per kind
+constexpr uint64_t PCKEY_INDEX[COLOR_NB][PIECE_TYPE_NB] = {
+    { 0, 1ull << 0, 1ull << 4, 1ull << 8, 1ull << 12, 1ull << 16, 0 },
+    { 0, 1ull << 20, 1ull << 24, 1ull << 28,  1ull << 32, 1ull << 36, 0 },
+};
+
+template<Piece p, Piece ...pcs>
+constexpr uint64_t pckey_v = pckey_v<p> | pckey_v<pcs...>;
+
+template<Piece p>
+constexpr uint64_t pckey_v<p> = PCKEY_INDEX[static_cast<int>(color_of(p))][type_of(p)];
+
 #endif
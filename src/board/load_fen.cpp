@@ -1,4 +1,5 @@
 #include "board.hpp"
+#include <algorithm>
 #include <cstring>
 #include "../parse_helpers.hpp"
 #include "../primitives/utility.hpp"
@@ -54,13 +55,33 @@ bool Board::load_fen(std::string_view fen) {
 
     next_word(fen);
     castling_ = castling_from_str(fen);
-    key_ ^= ZOBRIST.castling[castling_];
+    //rights without the king and rook at home would castle through nothing
+    if (pieces_on_[SQ_E1] != W_KING || pieces_on_[SQ_H1] != W_ROOK)
+        castling_ = static_cast<CastlingRights>(castling_ & ~WHITE_KINGSIDE);
+    if (pieces_on_[SQ_E1] != W_KING || pieces_on_[SQ_A1] != W_ROOK)
+        castling_ = static_cast<CastlingRights>(castling_ & ~WHITE_QUEENSIDE);
+    if (pieces_on_[SQ_E8] != B_KING || pieces_on_[SQ_H8] != B_ROOK)
+        castling_ = static_cast<CastlingRights>(castling_ & ~BLACK_KINGSIDE);
+    if (pieces_on_[SQ_E8] != B_KING || pieces_on_[SQ_A8] != B_ROOK)
+        castling_ = static_cast<CastlingRights>(castling_ & ~BLACK_QUEENSIDE);
+    key_ ^=ZOBRIST.castling[castling_];
 
     next_word(fen);
     en_passant_ = square_from_str(fen);
     if (en_passant_ != SQ_NONE)
         key_ ^= ZOBRIST.enpassant[file_of(en_passant_)];
 
+    //optional, EPD lines have operations instead
+    next_word(fen);
+    int half_moves = 0;
+    for (; !fen.empty() && is_digit(fen.front()); fen = fen.substr(1))
+        half_moves = std::min(half_moves * 10 + fen.front() - '0', 100);
+    half_moves_ = static_cast<uint8_t>(half_moves);
+
+    //pins and checks need both kings
+    if (popcnt(pieces(WHITE, KING)) != 1 || popcnt(pieces(BLACK, KING)) != 1)
+        return false;
+
     update_pin_info();
 
     validate();
@@ -0,0 +1,176 @@
+#include "packed.hpp"
+#include "board.hpp"
+#include "../zobrist.hpp"
+#include <cstring>
+#include <sstream>
+
+PackedBoard pack(const Board &b, const int score, const int result) {
+    PackedBoard pb{};
+    pb.occupancy = b.pieces();
+    int i = 0;
+    for (Bitboard bb = pb.occupancy; bb; ++i) {
+        const auto p = static_cast<uint8_t>(b.piece_on(pop_lsb(bb)));
+        pb.pieces[i / 2] |= i & 1 ? p << 4 : p;
+    }
+    pb.stm = static_cast<uint8_t>(b.side_to_move());
+    pb.castling = static_cast<uint8_t>(b.castling());
+    pb.ep = static_cast<uint8_t>(b.en_passant());
+    pb.half_moves = b.half_moves();
+    pb.score = static_cast<int16_t>(score);
+    pb.result = static_cast<int8_t>(result);
+    return pb;
+}
+
+bool Board::load_packed(const PackedBoard &pb) {
+    memset(this, 0, sizeof(Board));
+    if (popcnt(pb.occupancy) > 32 || pb.stm > BLACK || pb.castling > ALL_CASTLING
+            || (pb.ep != SQ_NONE && !is_ok(static_cast<Square>(pb.ep))))
+        return false;
+
+    int i = 0;
+    for (Bitboard bb = pb.occupancy; bb; ++i) {
+        const auto p = static_cast<Piece>(pb.pieces[i / 2] >> (i & 1 ? 4 : 0) & 15);
+        if (!is_ok(p))
+            return false;
+        put_piece(p, pop_lsb(bb));
+    }
+
+    side_to_move_ = static_cast<Color>(pb.stm);
+    if (side_to_move_ == BLACK)
+        key_ ^= ZOBRIST.side;
+
+    castling_ = static_cast<CastlingRights>(pb.castling);
+    key_ ^= ZOBRIST.castling[castling_];
+
+    en_passant_ = static_cast<Square>(pb.ep);
+    if (en_passant_ != SQ_NONE)
+        key_ ^= ZOBRIST.enpassant[file_of(en_passant_)];
+
+    half_moves_ = pb.half_moves;
+
+    if (popcnt(pieces(WHITE, KING)) != 1 || popcnt(pieces(BLACK, KING)) != 1)
+        return false;
+
+    update_pin_info();
+
+    validate();
+
+    return true;
+}
+
+PackedWriter::~PackedWriter() {
+    close();
+}
+
+bool PackedWriter::open(const std::string &path, const bool append) {
+    close();
+    out_.open(path, std::ios::binary | (append ? std::ios::app : std::ios::trunc));
+    buffer_.reserve(BUFFER_SIZE);
+    count_ = 0;
+    return out_.good();
+}
+
+void PackedWriter::close() {
+    if (!out_.is_open())
+        return;
+    flush();
+    out_.close();
+}
+
+void PackedWriter::write(const PackedBoard &pb) {
+    buffer_.push_back(pb);
+    ++count_;
+    if (buffer_.size() >= BUFFER_SIZE)
+        flush();
+}
+
+void PackedWriter::write(const PackedBoard *pbs, const size_t n) {
+    flush();
+    out_.write(reinterpret_cast<const char*>(pbs),
+            static_cast<std::streamsize>(n * sizeof(PackedBoard)));
+    count_ += n;
+}
+
+void PackedWriter::flush() {
+    out_.write(reinterpret_cast<const char*>(buffer_.data()),
+            static_cast<std::streamsize>(buffer_.size() * sizeof(PackedBoard)));
+    out_.flush();
+    buffer_.clear();
+}
+
+uint64_t PackedWriter::count() const {
+    return count_;
+}
+
+bool PackedReader::open(const std::string &path) {
+    close();
+    if (!file_.open(path) || file_.size() < sizeof(PackedBoard))
+        return false;
+    data_ = reinterpret_cast<const PackedBoard*>(file_.data());
+    size_ = file_.size() / sizeof(PackedBoard);
+    return true;
+}
+
+void PackedReader::close() {
+    file_.close();
+    data_ = nullptr;
+    size_ = 0;
+}
+
+size_t PackedReader::size() const {
+    return size_;
+}
+
+const PackedBoard &PackedReader::operator[](const size_t i) const {
+    return data_[i];
+}
+
+const PackedBoard *PackedReader::begin() const {
+    return data_;
+}
+
+const PackedBoard *PackedReader::end() const {
+    return data_ + size_;
+}
+
+uint64_t pack_file(const std::string &text, const std::string &packed) {
+    std::ifstream in(text);
+    PackedWriter out;
+    if (!in || !out.open(packed, false))
+        return 0;
+
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream is(line);
+        std::string fen;
+        std::getline(is, fen, '|');
+
+        Board b{};
+        if (!b.load_fen(fen))
+            continue;
+
+        int score = 0, result = 0;
+        char sep;
+        is >> score >> sep >> result;
+        out.write(pack(b, score, result));
+    }
+    return out.count();
+}
+
+uint64_t unpack_file(const std::string &packed, const std::string &text) {
+    PackedReader in;
+    std::ofstream out(text);
+    if (!in.open(packed) || !out)
+        return 0;
+
+    uint64_t n = 0;
+    for (const PackedBoard &pb: in) {
+        Board b{};
+        if (!b.load_packed(pb))
+            continue;
+        out << b.fen() << " | " << pb.score << " | "
+            << static_cast<int>(pb.result) << '\n';
+        ++n;
+    }
+    return n;
+}
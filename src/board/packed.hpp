@@ -0,0 +1,85 @@
+#ifndef PACKED_HPP
+#define PACKED_HPP
+
+#include "../primitives/common.hpp"
+#include "../primitives/mapped_file.hpp"
+#include <fstream>
+#include <string>
+#include <vector>
+
+class Board;
+
+/*
+ * A position in 32 bytes. The pieces are 4-bit Piece codes in the order
+ * of the occupied squares from A1 up, the low nibble first. score and
+ * result are from the side to move's point of view, result is
+ * -1 (loss), 0 (draw) or 1 (win). Files are arrays of these, little-endian.
+ * */
+struct PackedBoard {
+    uint64_t occupancy;
+    uint8_t pieces[16];
+    uint8_t stm, castling, ep; //ep is SQ_NONE without en passant
+    uint8_t half_moves;
+    int16_t score;
+    int8_t result;
+    uint8_t pad;
+};
+
+static_assert(sizeof(PackedBoard) == 32);
+
+[[nodiscard]] PackedBoard pack(const Board &b, int score = 0, int result = 0);
+
+//Appends positions to a file through a buffer of BUFFER_SIZE entries
+class PackedWriter {
+public:
+    static constexpr size_t BUFFER_SIZE = 1 << 16;
+
+    PackedWriter() = default;
+    PackedWriter(const PackedWriter&) = delete;
+    PackedWriter& operator=(const PackedWriter&) = delete;
+    ~PackedWriter();
+
+    bool open(const std::string &path, bool append = true);
+    void close();
+
+    void write(const PackedBoard &pb);
+    void write(const PackedBoard *pbs, size_t n);
+    void flush();
+
+    //entries written since open(), buffered ones included
+    [[nodiscard]] uint64_t count() const;
+
+private:
+    std::ofstream out_;
+    std::vector<PackedBoard> buffer_;
+    uint64_t count_{};
+};
+
+//Random access to a file of positions without reading it up front
+class PackedReader {
+public:
+    //false if the file cannot be mapped or has no entries
+    bool open(const std::string &path);
+    void close();
+
+    [[nodiscard]] size_t size() const;
+    [[nodiscard]] const PackedBoard &operator[](size_t i) const;
+
+    [[nodiscard]] const PackedBoard *begin() const;
+    [[nodiscard]] const PackedBoard *end() const;
+
+private:
+    MappedFile file_;
+    const PackedBoard *data_{};
+    size_t size_{};
+};
+
+/*
+ * Text lines "<fen> | <score> | <result>" (the last two optional)
+ * to a packed file and back. Return the number of positions converted,
+ * lines with an invalid FEN are skipped.
+ * */
+uint64_t pack_file(const std::string &text, const std::string &packed);
+uint64_t unpack_file(const std::string &packed, const std::string &text);
+
+#endif
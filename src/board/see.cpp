@@ -1,6 +1,8 @@
 #include "board.hpp"
 #include "../movgen/attack.hpp"
 #include "../core/eval.hpp"
+#include "../movgen/generate.hpp"
+#include <algorithm>
 
 bool Board::see_ge(const Move m, const int threshold) const {
     if (type_of(m) != NORMAL)
@@ -85,3 +87,83 @@ bool Board::see_ge(const Move m, const int threshold) const {
     return res;
 }
 
+
+void Board::see_all(ExtMove *begin, ExtMove *end) const {
+    Bitboard attackers_on[SQUARE_NB];
+    Bitboard known = 0;
+
+    for (ExtMove *it = begin; it != end; ++it) {
+        const Move m = it->move;
+        const Square from = from_sq(m), to = to_sq(m);
+        const Bitboard from_bb = square_bb(from);
+
+        if (!(known & square_bb(to))) {
+            attackers_on[to] = attackers_to(to, combined_);
+            known |= square_bb(to);
+        }
+
+        //the target square is left empty, so that a captured pinner
+        //no longer pins
+        Bitboard occupied = combined_ ^ from_bb ^ (combined_ & square_bb(to));
+        PieceType victim = type_of(piece_on(to)),
+                  attacker = type_of(piece_on(from));
+        if (type_of(m) == EN_PASSANT) {
+            occupied ^= square_bb(make_square(file_of(to), rank_of(from)));
+            victim = PAWN;
+        }
+
+        int gain[32], d = 0;
+        gain[0] = mg_value[victim];
+        if (type_of(m) == PROMOTION) {
+            attacker = prom_type(m);
+            gain[0] += mg_value[attacker] - mg_value[PAWN];
+        }
+
+        //sliders behind the moved piece or the en passant pawn
+        Bitboard attackers = (attackers_on[to] & occupied)
+            | (attacks_bb<BISHOP>(to, occupied) & pieces(BISHOP, QUEEN))
+            | (attacks_bb<ROOK>(to, occupied) & pieces(ROOK, QUEEN));
+
+        Color stm = ~side_to_move_;
+        while (true) {
+            attackers &= occupied;
+            Bitboard stm_attackers = attackers & pieces(stm);
+            if (pinners(~stm) & occupied)
+                stm_attackers &= ~blockers_for_king(stm);
+            if (!stm_attackers)
+                break;
+
+            PieceType pt = PAWN;
+            while (!(stm_attackers & pieces(pt)))
+                ++pt;
+
+            //the king may only recapture if nothing defends
+            if (pt == KING && (attackers & pieces(~stm) & occupied))
+                break;
+
+            //a king capture ends the exchange, its value is irrelevant
+            ++d;
+            gain[d] = (attacker == KING ? mg_value[QUEEN] * 2 
+                : mg_value[attacker]) - gain[d - 1];
+            if (d == 31)
+                break;
+
+            attacker = pt;
+            occupied ^= lss_bb(stm_attackers & pieces(pt));
+            if (pt == PAWN || pt == BISHOP || pt == QUEEN)
+                attackers |= attacks_bb<BISHOP>(to, occupied)
+                    & pieces(BISHOP, QUEEN);
+            if (pt == ROOK || pt == QUEEN)
+                attackers |= attacks_bb<ROOK>(to, occupied)
+                    & pieces(ROOK, QUEEN);
+
+            stm = ~stm;
+        }
+
+        while (d) {
+            gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+            --d;
+        }
+        it->value = gain[0];
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef BOOK_POLYGLOT_HPP
+#define BOOK_POLYGLOT_HPP
+
+#include "../primitives/common.hpp"
+#include "../primitives/mapped_file.hpp"
+#include <cstddef>
+#include <random>
+#include <string>
+
+class Board;
+
+/*
+ * Polyglot opening books (.bin): 16 byte big-endian entries
+ * (key, move, weight, learn) sorted by the Polyglot hash of the position.
+ * The file is mmapped and the entries of a position are found
+ * by binary search, so a probe costs a few page touches.
+ * */
+namespace polyglot {
+
+//the hash Polyglot books are keyed by, unrelated to Board::key()
+[[nodiscard]] uint64_t key(const Board &b);
+
+class Book {
+public:
+    Book() = default;
+    Book(const Book&) = delete;
+    Book& operator=(const Book&) = delete;
+    ~Book();
+
+    //"" or "<empty>" closes the book. Returns the number of entries
+    size_t open(const std::string &path);
+    void close();
+
+    [[nodiscard]] size_t size() const;
+
+    //Weighted random choice among the legal book moves of b,
+    //MOVE_NONE if there are none
+    Move probe(const Board &b);
+
+private:
+    MappedFile file_;
+    const uint8_t *data_{};
+    size_t size_{};
+    std::mt19937_64 rng_{std::random_device{}()};
+};
+
+} //namespace polyglot
+
+#endif
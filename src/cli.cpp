@@ -2,30 +2,44 @@
 #include "primitives/utility.hpp"
 #include <algorithm>
 #include <cassert>
+#include <cstdlib>
 #include <sstream>
+#include <thread>
 #include "tree.hpp"
 #include "tt.hpp"
+#include "bench.hpp"
+#include "perft.hpp"
+#include "analyze.hpp"
+#include "server.hpp"
+#include "datagen.hpp"
+#include "match.hpp"
+#include "tune.hpp"
+#include "train.hpp"
+#include "board/packed.hpp"
+#include "syzygy/tbprobe.hpp"
 
 namespace {
 
 template<bool root>
-void print_tree(std::vector<size_t> &nodes, const size_t parent, const int depth) {
+void print_tree(const Tree &tree, std::vector<size_t> &nodes, 
+        const size_t parent, const int depth) 
+{
     if (!root) {
         nodes.push_back(parent);
-        std::cout << g_tree.nodes[parent] << '\n';
+        std::cout << tree.nodes[parent] << '\n';
     }
     if (!depth)
         return;
 
-    size_t child = root ? 0 : g_tree.first_child(parent);
+    size_t child = root ? 0 : tree.first_child(parent);
     while (child != Tree::npos) {
-        print_tree<false>(nodes, child, depth - 1);
-        child = g_tree.next_child(child);
+        print_tree<false>(tree, nodes, child, depth - 1);
+        child = tree.next_child(child);
     }
 }
 
-void tree_walker() {
- if (!g_tree.size())
+void tree_walker(const Tree &tree) {
+    if (!tree.size())
         return;
 
     int depth = 1;
@@ -37,9 +51,9 @@ void tree_walker() {
     while (true) {
         nodes.clear();
         if (parent == Tree::npos)
-            print_tree<true>(nodes, parent, depth);
+            print_tree<true>(tree, nodes, parent, depth);
         else
-            print_tree<false>(nodes, parent, depth);
+            print_tree<false>(tree, nodes, parent, depth);
 
         std::cout << "walker> ";
         std::cin >> token;
@@ -55,7 +69,7 @@ void tree_walker() {
 	        for (const size_t i: nodes) {
 		        ss.str("");
 		        ss.clear();
-		        ss << g_tree.nodes[i].played;
+		        ss << tree.nodes[i].played;
 		        if (ss.str() == token) {
 			        parent = i;
 			        break;
@@ -65,7 +79,7 @@ void tree_walker() {
         } else if (token == "root") {
 	        parent = Tree::npos;
         } else if (token == "up") {
-	        parent = g_tree.parent(parent);
+	        parent = tree.parent(parent);
         }
     }
 }
@@ -106,67 +120,101 @@ std::istream& operator>>(std::istream& is, UciOption &opt) {
 }
 
 UCIContext::UCIContext() {
-    options_["hash"] = UciSpin { 4, 1024, 128 };
-}
-
-void UCIContext::enter_loop() {
     board_ = Board::start_pos();
     st_.reset();
 
-    std::string s, cmd;
-    std::istringstream is;
-
-    do {
-        if (!std::getline(std::cin, s))
-            s = "quit";
+    options_["hash"] = UciSpin { 4, 1024, 128 };
+    options_["trace"] = UciSpin { 0, 4096, 0 };
+    options_["syzygypath"] = std::string("<empty>");
+    options_["pnsearch"] = true;
+    options_["book"] = false;
+    options_["bookfile"] = std::string("<empty>");
+#ifdef RUNTIME_FEATURES
+    for (auto name: FEATURE_NAMES)
+        options_[name] = true;
+#endif
+}
 
-        is.str(s);
-        is.clear();
-        cmd.clear();
-        is >> cmd;
+void UCIContext::enter_loop() {
+    std::string s;
+    while (std::getline(std::cin, s) && execute(s));
+}
 
-        if (cmd == "isready") sync_cout() << "readyok\n";
-        else if (cmd == "uci") print_info();
-        else if (cmd == "position") parse_position(is);
-        else if (cmd == "go") parse_go(is);
-        else if (cmd == "setoption") parse_setopt(is);
-        else if (cmd == "stop") search_.stop();
-        else if (cmd == "d") sync_cout() << board_;
-        else if (cmd == "tree") tree_walker();
-        else if (cmd == "quit") break;
+bool UCIContext::execute(const std::string &s) {
+    std::istringstream is(s);
+    std::string cmd;
+    is >> cmd;
+
+    if (cmd == "isready") sync_cout() << "readyok\n";
+    else if (cmd == "uci") print_info();
+    else if (cmd == "ucinewgame") search_.new_game();
+    else if (cmd == "position") parse_position(is);
+    else if (cmd == "go") parse_go(is);
+    else if (cmd == "setoption") parse_setopt(is);
+    else if (cmd == "stop") {
+        search_.stop();
+        mate_.stop();
+    }
+    else if (cmd == "d") sync_cout() << board_;
+    else if (cmd == "tree") parse_tree(is);
+    else if (cmd == "bench") parse_bench(is);
+    else if (cmd == "perft") parse_perft(is);
+    else if (cmd == "analyze") parse_analyze(is);
+    else if (cmd == "serve") parse_serve(is);
+    else if (cmd == "datagen") parse_datagen(is);
+    else if (cmd == "match") parse_match(is);
+    else if (cmd == "tune") parse_tune(is);
+    else if (cmd == "train") parse_train(is);
+    else if (cmd == "convert") parse_convert(is);
+    else if (cmd == "tbcheck") check_tablebases();
+    else if (cmd == "tbprobe") probe_tablebases();
+#ifdef SEARCH_STATS
+    else if (cmd == "stats") {
+        search_.wait_for_completion();
+        std::ostringstream ss;
+        search_.counters().json(ss);
+        sync_cout() << ss.str();
+    }
+#endif
+    else if (cmd == "quit") return false;
 
-    } while (s != "quit");
+    return true;
 }
 
-void UCIContext::parse_position(std::istream &is) {
+bool read_position(std::istream &is, Board &b, Stack &st) {
     std::string s;
     is >> s;
-    st_.reset();
+    st.reset();
 
     if (s == "fen") {
 	    std::string fen;
 	    while (is >> s && s != "moves")
             fen += s + ' ';
-        const bool result = board_.load_fen(fen);
-        assert(result);
+        if (!b.load_fen(fen))
+            return false;
     } else if (s == "startpos") {
-        board_ = Board::start_pos();
+        b = Board::start_pos();
         is >> s; //consume "moves"
     } else {
-        return;
+        return false;
     }
 
-    if (s != "moves")
-        return;
-
-    while (is >> s) {
-	    const Move m = move_from_str(board_, s);
-        if (m == MOVE_NONE)
-            break;
-        st_.push(board_.key(), m);
-        board_ = board_.do_move(m);
+    if (s == "moves") {
+        while (is >> s) {
+	        const Move m = move_from_str(b, s);
+            if (m == MOVE_NONE)
+                break;
+            st.push(b.key(), m, 0, b.piece_on(from_sq(m)));
+            b = b.do_move(m);
+        }
     }
-    st_.set_start(st_.height());
+    st.set_start(st.height());
+    return true;
+}
+
+void UCIContext::parse_position(std::istream &is) {
+    [[maybe_unused]] const bool result = read_position(is, board_, st_);
+    assert(result);
 }
 
 void UCIContext::parse_go(std::istream &is) {
@@ -180,17 +228,332 @@ void UCIContext::parse_go(std::istream &is) {
         else if (token == "winc") is >> limits.inc[WHITE];
         else if (token == "binc") is >> limits.inc[BLACK];
         else if (token == "movetime") is >> limits.move_time;
-        else if (token == "infinite") limits.infinite = true;
+        else if (token == "infinite") limits.infinite = limits.until_stop = true;
         else if (token == "depth") is >> limits.max_depth;
+        else if (token == "mate") is >> limits.mate;
+        else if (token == "nodes") is >> limits.nodes;
     }
 
     if (!limits.time[WHITE] && !limits.time[BLACK]
             && !limits.move_time)
         limits.infinite = true;
 
+    //"go mate" goes to the proof-number search unless it is switched off,
+    //then alpha-beta looks for the mate to the matching depth
+    if (limits.mate > 0) {
+        search_.stop();
+        search_.wait_for_completion();
+        if (const auto pns = std::get_if<bool>(&options_["pnsearch"]); pns && *pns) {
+            mate_.go(board_, limits);
+            return;
+        }
+        limits.max_depth = std::min(2 * limits.mate - 1, MAX_DEPTH);
+    }
+    mate_.stop();
+    mate_.wait_for_completion();
+
+    //a book move is played without searching,
+    //analysis (go infinite) must wait for "stop" so it always searches
+    if (const auto book = std::get_if<bool>(&options_["book"]); 
+            book && *book && !limits.until_stop) {
+        if (const Move m = book_.probe(board_); m != MOVE_NONE) {
+            search_.wait_for_completion();
+            sync_cout() << "bestmove " << m << '\n';
+            return;
+        }
+    }
+
     search_.go(board_, st_, limits);
 }
 
+void UCIContext::parse_bench(std::istream &is) {
+    std::string token, epd;
+    is >> token;
+    if (token == "ordering") {
+        int picks = 3;
+        is >> picks;
+        bench_ordering(picks);
+        return;
+    }
+
+    if (token == "eval") {
+        bench_eval();
+        return;
+    }
+
+    if (token == "latency") {
+        int hash = 256;
+        is >> hash;
+        bench_latency(hash);
+        return;
+    }
+
+    int depth = 10;
+    std::istringstream(token) >> depth;
+    is >> epd;
+
+    search_.stop();
+    bench(search_, depth, epd);
+}
+
+void UCIContext::parse_perft(std::istream &is) {
+    std::string token;
+    int threads = 1, hash = 0;
+    is >> token >> threads >> hash;
+    threads = std::max(threads, 1);
+
+    std::ostringstream ss;
+    const TimePoint start = timer::now();
+    uint64_t total = 0;
+    if (token == "test") {
+        const int failed = perft_test_positions(threads, hash);
+        if (failed)
+            ss << "Failed position " << failed << '\n';
+        else
+            ss << "All positions passed\n";
+    } else {
+        int depth = 0;
+        if (!(std::istringstream(token) >> depth) || depth < 0) {
+            sync_cout() << "info string perft: bad depth " << token << '\n';
+            return;
+        }
+        //depth 0 counts the root itself and has no moves to divide
+        if (!depth) {
+            total = perft(board_, 0);
+        } else {
+            for (const auto &[m, nodes]: perft_divide(board_, depth, threads, hash)) {
+                ss << m << ": " << nodes << '\n';
+                total += nodes;
+            }
+        }
+        ss << "\nNodes: " << total << '\n';
+    }
+
+    const TimePoint elapsed = timer::now() - start;
+    ss << "Time (ms): " << elapsed << '\n';
+    if (total)
+        ss << "Nodes/second: " << total * 1000 / (elapsed + 1) << '\n';
+    sync_cout() << ss.str();
+}
+
+void UCIContext::check_tablebases() {
+    const TimePoint start = timer::now();
+    const syzygy::CheckResult res = syzygy::check_tables();
+
+    std::ostringstream ss;
+    ss << "Tables: " << res.tables
+       << "\nPositions: " << res.positions
+       << "\nMismatches: " << res.mismatches << '\n';
+    if (res.mismatches)
+        ss << "First: " << res.first_mismatch << '\n';
+    ss << "Time (ms): " << timer::now() - start << '\n';
+    sync_cout() << ss.str();
+}
+
+void UCIContext::probe_tablebases() {
+    syzygy::ProbeState wdl_state, dtz_state;
+    const int wdl = syzygy::probe_wdl(board_, wdl_state);
+    const int dtz = syzygy::probe_dtz(board_, dtz_state);
+
+    std::ostringstream ss;
+    if (board_.castling() || wdl_state == syzygy::PROBE_FAIL
+            || dtz_state == syzygy::PROBE_FAIL)
+        ss << "info string tbprobe: no table for " << board_.fen() << '\n';
+    else
+        ss << "WDL: " << wdl << "\nDTZ: " << dtz << '\n';
+    sync_cout() << ss.str();
+}
+
+void UCIContext::parse_analyze(std::istream &is) {
+    std::string epd, token;
+    is >> epd;
+
+    SearchLimits limits;
+    limits.max_depth = 10;
+    limits.infinite = true;
+    int threads = 1;
+    while (is >> token) {
+        if (token == "depth") is >> limits.max_depth;
+        else if (token == "threads") is >> threads;
+        else if (token == "nodes") {
+            is >> limits.nodes;
+            limits.max_depth = MAX_DEPTH;
+        }
+        else if (token == "movetime") {
+            is >> limits.move_time;
+            limits.infinite = false;
+            limits.max_depth = MAX_DEPTH;
+        }
+    }
+    limits.max_depth = std::clamp(limits.max_depth, 1, MAX_DEPTH - 1);
+
+    search_.stop();
+    mate_.stop();
+    analyze(epd, limits, threads);
+}
+
+void UCIContext::parse_serve(std::istream &is) {
+    std::string path;
+    int threads = static_cast<int>(std::thread::hardware_concurrency()), hash = 0;
+    is >> path >> threads >> hash;
+
+    search_.stop();
+    search_.wait_for_completion();
+    mate_.stop();
+    mate_.wait_for_completion();
+    if (hash > 0)
+        g_tt.resize(hash);
+    serve(path, threads);
+}
+
+void UCIContext::parse_datagen(std::istream &is) {
+    std::string path, token;
+    is >> path;
+
+    DatagenConfig cfg;
+    cfg.limits.max_depth = 8;
+    while (is >> token) {
+        if (token == "games") is >> cfg.games;
+        else if (token == "depth") is >> cfg.limits.max_depth;
+        else if (token == "threads") is >> cfg.threads;
+        else if (token == "random") is >> cfg.random_plies;
+        else if (token == "nodes") {
+            is >> cfg.limits.nodes;
+            cfg.limits.max_depth = MAX_DEPTH - 1;
+        }
+    }
+    cfg.limits.max_depth = std::clamp(cfg.limits.max_depth, 1, MAX_DEPTH - 1);
+
+    search_.stop();
+    mate_.stop();
+    datagen(path, cfg);
+}
+
+void UCIContext::parse_match(std::istream &is) {
+    std::string path, token, value;
+    is >> path;
+
+    MatchConfig cfg;
+    for (auto &side: cfg.sides)
+        side.limits.max_depth = 8;
+    while (is >> token) {
+        if (token == "games") is >> cfg.games;
+        else if (token == "threads") is >> cfg.threads;
+        else if (token == "hash") is >> cfg.hash;
+        else if (token == "elo0") is >> cfg.elo0;
+        else if (token == "elo1") is >> cfg.elo1;
+        else if (is >> value) {
+            //"a." or "b." sets one side only
+            int first = 0, last = 1;
+            if (token.size() > 2 && (token[0] == 'a' || token[0] == 'b') && token[1] == '.') {
+                first = last = token[0] - 'a';
+                token.erase(0, 2);
+            }
+            for (int i = first; i <= last; ++i) {
+                if (!cfg.sides[i].set(token, value)) {
+                    sync_cout() << "info string match: cannot set "
+                        << token << ' ' << value << '\n';
+                    return;
+                }
+            }
+        }
+    }
+
+    search_.stop();
+    mate_.stop();
+    match(path, cfg);
+}
+
+void UCIContext::parse_tune(std::istream &is) {
+    std::string path, out, token;
+    is >> path >> out;
+
+    TuneConfig cfg;
+    while (is >> token) {
+        if (token == "epochs") is >> cfg.epochs;
+        else if (token == "threads") is >> cfg.threads;
+        else if (token == "rate") is >> cfg.rate;
+        else if (token == "lambda") is >> cfg.lambda;
+    }
+    cfg.lambda = std::clamp(cfg.lambda, 0.0, 1.0);
+
+    search_.stop();
+    mate_.stop();
+    tune(path, out, cfg);
+}
+
+void UCIContext::parse_train(std::istream &is) {
+    std::string path, out, token;
+    is >> path >> out;
+
+    TrainConfig cfg;
+    while (is >> token) {
+        if (token == "epochs") is >> cfg.epochs;
+        else if (token == "batch") is >> cfg.batch;
+        else if (token == "threads") is >> cfg.threads;
+        else if (token == "rate") is >> cfg.rate;
+        else if (token == "lambda") is >> cfg.lambda;
+        else if (token == "init") is >> cfg.init;
+    }
+    cfg.batch = std::max(cfg.batch, 1);
+    cfg.lambda = std::clamp(cfg.lambda, 0.0, 1.0);
+
+    search_.stop();
+    mate_.stop();
+    train(path, out, cfg);
+}
+
+void UCIContext::parse_convert(std::istream &is) {
+    std::string in, out;
+    is >> in >> out;
+
+    const TimePoint start = timer::now();
+    const bool to_text = in.size() >= 4 && in.compare(in.size() - 4, 4, ".bin") == 0;
+    const uint64_t n = to_text ? unpack_file(in, out) : pack_file(in, out);
+    const TimePoint elapsed = timer::now() - start;
+
+    std::ostringstream ss;
+    ss << "Positions: " << n
+       << "\nTime (ms): " << elapsed
+       << "\nPositions/second: " << n * 1000 / (elapsed + 1) << '\n';
+    sync_cout() << ss.str();
+}
+
+void UCIContext::parse_tree(std::istream &is) {
+    std::string op, path;
+    is >> op >> path;
+
+    search_.wait_for_completion();
+    Tree &last = search_.tree();
+    if (op.empty()) {
+        if (last.dropped())
+            sync_cout() << "info string " << last.dropped() 
+                << " nodes did not fit\n";
+        tree_walker(last);
+    } else if (op == "save") {
+        if (!last.save(path))
+            sync_cout() << "info string cannot write " << path << '\n';
+    } else if (op == "load" || op == "json") {
+        Tree loaded;
+        const Tree *tree = &last;
+        if (!path.empty()) {
+            if (!loaded.load(path)) {
+                sync_cout() << "info string cannot load " << path << '\n';
+                return;
+            }
+            tree = &loaded;
+        }
+
+        if (op == "load") {
+            tree_walker(*tree);
+        } else {
+            std::ostringstream ss;
+            tree->json(ss);
+            sync_cout() << ss.str();
+        }
+    }
+}
+
 void UCIContext::parse_setopt(std::istream &is) {
     std::string name, op;
     is >> name >> name >> op;
@@ -219,6 +582,47 @@ void UCIContext::update_option(const std::string_view name,
             g_tt.clear();
         }
     }
+
+    //trace buffer size in MiB, 0 turns tracing off
+    if (name == "trace") {
+        if (const auto spin = std::get_if<UciSpin>(&opt)) {
+            search_.stop();
+            search_.wait_for_completion();
+            search_.tree().set_capacity(
+                static_cast<size_t>(spin->value) * 1024 * 1024 / sizeof(Node));
+        }
+    }
+
+    if (name == "syzygypath") {
+        if (const auto path = std::get_if<std::string>(&opt)) {
+            search_.stop();
+            search_.wait_for_completion();
+            const int found = syzygy::init(*path);
+            std::ostringstream ss;
+            ss << "info string found " << found
+               << " tablebases, up to " << syzygy::max_pieces() << " pieces\n";
+#ifndef TB_SEARCH
+            if (found)
+                ss << "info string search does not probe them, build with TB_SEARCH\n";
+#endif
+            sync_cout() << ss.str();
+        }
+    }
+
+    if (name == "bookfile") {
+        if (const auto path = std::get_if<std::string>(&opt)) {
+            const size_t entries = book_.open(*path);
+            if (*path != "<empty>")
+                sync_cout() << "info string book " << *path << ": "
+                    << entries << " entries\n";
+        }
+    }
+
+    for (int i = 0; i < FEATURE_NB; ++i) {
+        if (const auto on = std::get_if<bool>(&opt); 
+                on && name == FEATURE_NAMES[i])
+            search_.features().set(static_cast<SearchFeature>(i), *on);
+    }
 }
 
 void UCIContext::print_info() {
@@ -235,10 +639,17 @@ void UCIContext::print_info() {
 }
 
 int enter_cli(const int argc, char **argv) {
-    (void)(argc);
-    (void)(argv);
-
     UCIContext uci;
+
+    //one-shot commands, e.g. "saturn bench 12" for PGO builds
+    if (argc > 1) {
+        std::string args;
+        for (int i = 1; i < argc; ++i)
+            args += std::string(argv[i]) + ' ';
+        uci.execute(args);
+        return 0;
+    }
+
     uci.enter_loop();
 
     return 0;
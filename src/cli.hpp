@@ -10,6 +10,8 @@
 #include "board/board.hpp"
 #include "searchstack.hpp"
 #include "core/searchworker.hpp"
+#include "core/dfpn.hpp"
+#include "book/polyglot.hpp"
 
 struct CoutWrapper {
     CoutWrapper(std::mutex &mtx) 
@@ -44,10 +46,37 @@ public:
 
     void enter_loop();
 
+    //returns false on "quit"
+    bool execute(const std::string &cmd);
+
 private:
     void parse_position(std::istream &is);
     void parse_go(std::istream &is);
     void parse_setopt(std::istream &is);
+    void parse_bench(std::istream &is);
+    //perft <depth> [threads] [hash], perft test [threads] [hash]
+    void parse_perft(std::istream &is);
+    //analyze <file.epd> [depth N | movetime N | nodes N] [threads N]
+    void parse_analyze(std::istream &is);
+    //serve <socket> [threads] [hash]
+    void parse_serve(std::istream &is);
+    //datagen <file> [games N] [depth N | nodes N] [threads N] [random N]
+    void parse_datagen(std::istream &is);
+    //match <openings> [games N] [threads N] [elo0 X] [elo1 Y] [[a.|b.]<limit|feature> V]
+    void parse_match(std::istream &is);
+    //tune <positions.bin> <out> [epochs N] [threads N] [rate X] [lambda X]
+    void parse_tune(std::istream &is);
+    //train <positions.bin> <out.bin> [epochs N] [batch N] [threads N]
+    //      [rate X] [lambda X] [init <net>]
+    void parse_train(std::istream &is);
+    //convert <in> <out>: text to packed positions, or back if in is a .bin
+    void parse_convert(std::istream &is);
+    //tbcheck: the loaded 3-piece pawnless tables against a retrograde solution
+    void check_tablebases();
+    //tbprobe: WDL and DTZ of the current position, for spot checks
+    void probe_tablebases();
+    //tree [save <file> | load <file> | json [file]]
+    void parse_tree(std::istream &is);
 
     void update_option(std::string_view name, 
             std::string_view op, const UciOption &opt);
@@ -58,8 +87,13 @@ private:
     Board board_{};
     Stack st_;
     SearchWorker search_;
+    MateSearch mate_;
+    polyglot::Book book_;
 };
 
+//"startpos | fen <fen>" and "moves ...", false if there is no valid position
+bool read_position(std::istream &is, Board &b, Stack &st);
+
 int enter_cli(int argc, char **argv);
 
 #endif
@@ -0,0 +1,291 @@
+#include "dfpn.hpp"
+#include "../cli.hpp"
+#include "../movgen/generate.hpp"
+#include "../primitives/utility.hpp"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+/*
+ * FILE: dfpn.cpp
+ * Nagai's df-pn. At an OR node (attacker to move) the proof number is the
+ * smallest one of the children and the disproof number is their sum,
+ * at an AND node it is the other way round. mid() keeps expanding the most
+ * proving child until the node's numbers reach the thresholds it was
+ * given, so the search stays in one subtree as long as it is the best one.
+ * Children are initialised by mobility: an attacker's move that leaves
+ * the defender few replies is cheap to prove.
+ * */
+
+namespace {
+
+constexpr uint32_t PN_INF = 100'000'000;
+constexpr size_t TABLE_SIZE = 1 << 20; //entries, a power of two
+
+uint32_t saturated_add(const uint32_t a, const uint32_t b) {
+    return std::min(PN_INF, a + b);
+}
+
+//different for every depth, so that a position gets one entry per depth
+uint64_t depth_key(const Board &b, const int depth) {
+    return b.key() ^ (0x9E3779B97F4A7C15ull * (depth + 1));
+}
+
+} //namespace
+
+MateSearch::MateSearch() {
+    loop_.start([this] { solve(); });
+}
+
+void MateSearch::go(const Board &root, const SearchLimits &limits) {
+    loop_.pause();
+    loop_.wait_for_completion();
+
+    root_ = root;
+    limits_ = limits;
+    man_.start = limits.start;
+    man_.max_time = limits.move_time;
+    man_.init(limits, root.side_to_move(), 0);
+    nodes_ = next_check_ = 0;
+
+    //allocated on the first "go mate" only
+    if (table_.empty())
+        table_.resize(TABLE_SIZE);
+    memset(table_.data(), 0, table_.size() * sizeof(ProofEntry));
+
+    loop_.resume();
+}
+
+void MateSearch::stop() {
+    loop_.pause();
+}
+
+void MateSearch::wait_for_completion() {
+    loop_.wait_for_completion();
+}
+
+void MateSearch::check_time() {
+    //nodes_ grows by whole expansions, so it can skip any given value
+    if (nodes_ < next_check_)
+        return;
+    next_check_ = nodes_ + 4096;
+    if (loop_.keep_going() && !limits_.infinite
+            && man_.out_of_time())
+        loop_.pause();
+}
+
+bool MateSearch::probe(const uint64_t key, Proof &p) const {
+    const size_t idx = key & (table_.size() - 2);
+    for (size_t i = idx; i < idx + 2; ++i) {
+        if (table_[i].key == key) {
+            p = { table_[i].pn, table_[i].dn };
+            return true;
+        }
+    }
+    return false;
+}
+
+void MateSearch::store(const uint64_t key, const Proof p, const uint64_t work) {
+    const size_t idx = key & (table_.size() - 2);
+    ProofEntry *e = &table_[idx];
+    if (e->key != key && (table_[idx + 1].key == key
+            || table_[idx + 1].work < e->work))
+        e = &table_[idx + 1];
+    *e = { key, p.pn, p.dn, work };
+}
+
+uint64_t MateSearch::work(const uint64_t key) const {
+    const size_t idx = key & (table_.size() - 2);
+    for (size_t i = idx; i < idx + 2; ++i)
+        if (table_[i].key == key)
+            return table_[i].work;
+    return 0;
+}
+
+//b is the position after the move, with depth plies left
+MateSearch::Proof MateSearch::initial(const Board &b, const int depth) const {
+    const bool or_node = depth & 1;
+    const int n = count_legal(b);
+    if (!n) {
+        //mated defender proves, a stalemate or mated attacker disproves
+        if (b.checkers() && !or_node)
+            return { 0, PN_INF };
+        return { PN_INF, 0 };
+    }
+
+    if (!depth) //the attacker did not mate in time
+        return { PN_INF, 0 };
+
+    const auto mobility = static_cast<uint32_t>(n);
+    return or_node ? Proof{ 1, mobility } : Proof{ mobility, 1 };
+}
+
+MateSearch::Proof MateSearch::lookup(const Board &b, const int depth) const {
+    Proof p{};
+    if (!probe(depth_key(b, depth), p))
+        p = initial(b, depth);
+    return p;
+}
+
+void MateSearch::mid(const Board &b, const int depth,
+        const uint32_t pn_t, const uint32_t dn_t, Proof &node)
+{
+    const bool or_node = depth & 1;
+    const uint64_t start_nodes = nodes_;
+
+    ExtMove moves[MAX_MOVES];
+    const int n = static_cast<int>(generate<LEGAL>(b, moves) - moves);
+    Proof children[MAX_MOVES];
+    for (int i = 0; i < n; ++i) {
+        children[i] = lookup(b.do_move(moves[i]), depth - 1);
+        ++nodes_;
+    }
+
+    while (true) {
+        //the numbers of this node and the two best children
+        uint32_t best = PN_INF + 1, second = PN_INF + 1, sum = 0;
+        int best_idx = 0;
+        for (int i = 0; i < n; ++i) {
+            const uint32_t v = or_node ? children[i].pn : children[i].dn;
+            if (v < best) {
+                second = best;
+                best = v;
+                best_idx = i;
+            } else if (v < second) {
+                second = v;
+            }
+            sum = saturated_add(sum, or_node ? children[i].dn : children[i].pn);
+        }
+        best = std::min(best, PN_INF);
+        second = std::min(second, PN_INF);
+        node = or_node ? Proof{ best, sum } : Proof{ sum, best };
+
+        check_time();
+        if (node.pn >= pn_t || node.dn >= dn_t || !loop_.keep_going())
+            break;
+
+        Proof &child = children[best_idx];
+        uint32_t child_pn_t, child_dn_t;
+        if (or_node) {
+            child_pn_t = std::min(pn_t, saturated_add(second, 1));
+            child_dn_t = saturated_add(dn_t - node.dn, child.dn);
+        } else {
+            child_dn_t = std::min(dn_t, saturated_add(second, 1));
+            child_pn_t = saturated_add(pn_t - node.pn, child.pn);
+        }
+
+        mid(b.do_move(moves[best_idx]), depth - 1, child_pn_t, child_dn_t, child);
+    }
+
+    store(depth_key(b, depth), node, nodes_ - start_nodes);
+}
+
+//attacker's mating moves and the defender's longest-lasting replies
+int MateSearch::extract_pv(Move *pv, const int depth) const {
+    Board b = root_;
+    int len = 0;
+    for (int d = depth; d > 0; --d) {
+        ExtMove moves[MAX_MOVES];
+        const int n = static_cast<int>(generate<LEGAL>(b, moves) - moves);
+
+        Move best = MOVE_NONE;
+        uint64_t best_work = 0;
+        for (int i = 0; i < n; ++i) {
+            const Board child = b.do_move(moves[i]);
+            if (lookup(child, d - 1).pn)
+                continue;
+
+            const uint64_t w = work(depth_key(child, d - 1));
+            if (best == MOVE_NONE || (!(d & 1) && w > best_work)) {
+                best = moves[i];
+                best_work = w;
+            }
+            if (d & 1)
+                break;
+        }
+
+        if (best == MOVE_NONE)
+            break;
+        pv[len++] = best;
+        b = b.do_move(best);
+    }
+    return len;
+}
+
+Move MateSearch::best_attempt(const int depth) const {
+    ExtMove moves[MAX_MOVES];
+    const int n = static_cast<int>(generate<LEGAL>(root_, moves) - moves);
+
+    Move best = MOVE_NONE;
+    Proof best_p{};
+    uint64_t best_work = 0;
+    for (int i = 0; i < n; ++i) {
+        const Board child = root_.do_move(moves[i]);
+        const Proof p = lookup(child, depth - 1);
+        const uint64_t w = work(depth_key(child, depth - 1));
+
+        //pn / dn < best pn / best dn, disproved moves (dn 0) come last,
+        //ties go to the move the search spent most nodes on
+        const uint64_t lhs = uint64_t{ p.pn } * best_p.dn;
+        const uint64_t rhs = uint64_t{ best_p.pn } * p.dn;
+        if (best == MOVE_NONE || lhs < rhs || (lhs == rhs && w > best_work)) {
+            best = moves[i];
+            best_p = p;
+            best_work = w;
+        }
+    }
+    return best;
+}
+
+void MateSearch::solve() {
+    ExtMove moves[MAX_MOVES];
+    const int n = static_cast<int>(generate<LEGAL>(root_, moves) - moves);
+    const int max_moves = std::clamp(limits_.mate, 1, MAX_DEPTH / 2);
+    std::ostringstream ss;
+
+    Move pv[MAX_DEPTH]{};
+    //disproved: mates up to that many moves are refuted
+    int pv_len = 0, depth = 0, disproved = 0;
+    for (int m = 1; n && m <= max_moves && loop_.keep_going(); ++m) {
+        depth = 2 * m - 1;
+        Proof root{};
+        mid(root_, depth, PN_INF, PN_INF, root);
+
+        const auto elapsed = timer::now() - limits_.start;
+        ss.str("");
+        ss.clear();
+        ss << "info depth " << depth
+           << " nodes " << nodes_
+           << " time " << elapsed
+           << " nps " << nodes_ * 1000 / (elapsed + 1);
+
+        if (!root.pn) {
+            pv_len = extract_pv(pv, depth);
+            ss << " score " << Score{mate_in(depth)} << " pv ";
+            for (int i = 0; i < pv_len; ++i)
+                ss << pv[i] << ' ';
+            sync_cout() << ss.str() << '\n';
+            break;
+        }
+        sync_cout() << ss.str() << '\n';
+        //neither proved nor disproved, the search was stopped
+        if (root.dn)
+            break;
+        disproved = m;
+    }
+
+    if (!pv_len) {
+        ss.str("");
+        ss.clear();
+        if (!n || disproved == max_moves) {
+            ss << "info string no mate in " << max_moves << " found";
+        } else {
+            ss << "info string mate search stopped";
+            if (disproved)
+                ss << ", no mate in " << disproved << " found";
+        }
+        sync_cout() << ss.str() << '\n';
+        pv[0] = !n ? MOVE_NONE : depth ? best_attempt(depth) : moves[0].move;
+    }
+    sync_cout() << "bestmove " << pv[0] << '\n';
+}
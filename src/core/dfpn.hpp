@@ -0,0 +1,63 @@
+#ifndef DFPN_HPP
+#define DFPN_HPP
+
+#include "../primitives/common.hpp"
+#include "../board/board.hpp"
+#include "search_common.hpp"
+#include "routine.hpp"
+#include <vector>
+
+struct ProofEntry {
+    uint64_t key;
+    uint32_t pn, dn;
+    uint64_t work; //nodes spent below, the cheaper entry gets replaced
+};
+
+/*
+ * Depth-first proof-number search for "go mate N".
+ * The side to move is the attacker, a node is proved when it mates
+ * within the plies left. The remaining depth is part of the hash key,
+ * so the search graph has no cycles and every proof is depth-exact.
+ * Mates of increasing length are tried in turn, which makes
+ * the first one found the shortest.
+ * */
+class MateSearch {
+public:
+    MateSearch();
+
+    void go(const Board &root, const SearchLimits &limits);
+
+    void stop();
+    void wait_for_completion();
+
+private:
+    struct Proof {
+        uint32_t pn, dn;
+    };
+
+    void solve();
+    void mid(const Board &b, int depth, uint32_t pn_t, uint32_t dn_t, Proof &node);
+
+    [[nodiscard]] Proof initial(const Board &b, int depth) const;
+    [[nodiscard]] Proof lookup(const Board &b, int depth) const;
+    bool probe(uint64_t key, Proof &p) const;
+    void store(uint64_t key, Proof p, uint64_t work);
+    [[nodiscard]] uint64_t work(uint64_t key) const;
+
+    int extract_pv(Move *pv, int depth) const;
+    //bestmove without a proof: the root move of the `depth` iteration
+    //with the lowest pn/dn, the one closest to a mate
+    [[nodiscard]] Move best_attempt(int depth) const;
+    void check_time();
+
+    Board root_;
+    SearchLimits limits_;
+    TimeMan man_{};
+    uint64_t nodes_{}, next_check_{};
+
+    std::vector<ProofEntry> table_;
+
+    Routine loop_;
+};
+
+#endif
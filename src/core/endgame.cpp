@@ -0,0 +1,321 @@
+#include "endgame.hpp"
+#include "eval.hpp"
+#include "../board/board.hpp"
+#include "../movgen/attack.hpp"
+#include "../movgen/generate.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * FILE: endgame.cpp
+ * The KPK bitbase is computed at startup by retrograde analysis:
+ * every position starts as a win, a draw, illegal or unknown, and
+ * the unknown ones are resolved from their successors until nothing changes.
+ * The evaluators return scores for the stronger side and are registered
+ * once per colour under the material key of that colour being stronger.
+ * */
+
+namespace {
+
+constexpr Bitboard DARK_SQUARES = 0xAA55AA55AA55AA55ull;
+
+//the pawn fields of the material key
+constexpr uint64_t PAWNS_KEY_MASK = 0xFull * (PCKEY_INDEX[WHITE][PAWN]
+    | PCKEY_INDEX[BLACK][PAWN]);
+
+constexpr int SCALE_NORMAL = 64;
+
+int distance(const Square s1, const Square s2) {
+    return std::max(std::abs(file_of(s1) - file_of(s2)),
+                    std::abs(rank_of(s1) - rank_of(s2)));
+}
+
+/*------------------------KPK------------------------*/
+
+//side to move, black king, white king, pawn file A-D, pawn rank 7-2
+constexpr int KPK_SIZE = 2 * 64 * 64 * 4 * 6;
+
+uint32_t KPK_BITBASE[KPK_SIZE / 32];
+
+int kpk_index(const Color stm, const Square bksq,
+        const Square wksq, const Square psq)
+{
+    return stm | (bksq << 1) | (wksq << 7) | (file_of(psq) << 13)
+        | ((RANK_7 - rank_of(psq)) << 15);
+}
+
+enum KPKResult : uint8_t {
+    KPK_INVALID = 0,
+    KPK_UNKNOWN = 1,
+    KPK_DRAW = 2,
+    KPK_WIN = 4,
+};
+
+struct KPKPosition {
+    KPKPosition() = default;
+    explicit KPKPosition(int idx);
+
+    KPKResult classify(const std::vector<KPKPosition> &db);
+
+    Color stm;
+    Square ksq[COLOR_NB];
+    Square psq;
+    KPKResult result;
+};
+
+KPKPosition::KPKPosition(const int idx) {
+    stm = static_cast<Color>(idx & 1);
+    ksq[BLACK] = static_cast<Square>((idx >> 1) & 0x3F);
+    ksq[WHITE] = static_cast<Square>((idx >> 7) & 0x3F);
+    psq = make_square(static_cast<File>((idx >> 13) & 3),
+                      static_cast<Rank>(RANK_7 - (idx >> 15)));
+
+    const Square push = sq_shift<NORTH>(psq);
+    const Bitboard black_moves = attacks_bb<KING>(ksq[BLACK]);
+
+    if (distance(ksq[WHITE], ksq[BLACK]) <= 1
+            || ksq[WHITE] == psq || ksq[BLACK] == psq
+            || (stm == WHITE && pawn_attacks_bb(WHITE, psq) & square_bb(ksq[BLACK])))
+        result = KPK_INVALID;
+    //promotes and the queen can't be taken
+    else if (stm == WHITE && rank_of(psq) == RANK_7 && ksq[WHITE] != push
+            && (distance(ksq[BLACK], push) > 1 || distance(ksq[WHITE], push) == 1))
+        result = KPK_WIN;
+    //stalemate or the pawn is taken
+    else if (stm == BLACK && (!(black_moves & ~(attacks_bb<KING>(ksq[WHITE])
+                    | pawn_attacks_bb(WHITE, psq)))
+                || black_moves & square_bb(psq) & ~attacks_bb<KING>(ksq[WHITE])))
+        result = KPK_DRAW;
+    else
+        result = KPK_UNKNOWN;
+}
+
+/*
+ * White wins if any move wins, black draws if any move draws.
+ * Illegal successors (including a captured pawn) are invalid
+ * and don't count, so a side without moves gets the bad result.
+ * */
+KPKResult KPKPosition::classify(const std::vector<KPKPosition> &db) {
+    const KPKResult good = stm == WHITE ? KPK_WIN : KPK_DRAW;
+    const KPKResult bad = stm == WHITE ? KPK_DRAW : KPK_WIN;
+
+    int r = KPK_INVALID;
+    Bitboard moves = attacks_bb<KING>(ksq[stm]);
+    while (moves) {
+        const Square to = pop_lsb(moves);
+        r |= stm == WHITE ? db[kpk_index(BLACK, ksq[BLACK], to, psq)].result
+                          : db[kpk_index(WHITE, to, ksq[WHITE], psq)].result;
+    }
+
+    if (stm == WHITE) {
+        const Square push = sq_shift<NORTH>(psq);
+        if (rank_of(psq) < RANK_7)
+            r |= db[kpk_index(BLACK, ksq[BLACK], ksq[WHITE], push)].result;
+        if (rank_of(psq) == RANK_2 && push != ksq[WHITE] && push != ksq[BLACK])
+            r |= db[kpk_index(BLACK, ksq[BLACK], ksq[WHITE],
+                    sq_shift<NORTH>(push))].result;
+    }
+
+    return result = r & good ? good : r & KPK_UNKNOWN ? KPK_UNKNOWN : bad;
+}
+
+void init_kpk() {
+    std::vector<KPKPosition> db(KPK_SIZE);
+    for (int idx = 0; idx < KPK_SIZE; ++idx)
+        db[idx] = KPKPosition(idx);
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto &pos: db)
+            changed |= pos.result == KPK_UNKNOWN
+                && pos.classify(db) != KPK_UNKNOWN;
+    }
+
+    for (int idx = 0; idx < KPK_SIZE; ++idx)
+        if (db[idx].result == KPK_WIN)
+            KPK_BITBASE[idx / 32] |= 1u << (idx & 31);
+}
+
+/*--------------------End of KPK---------------------*/
+
+/*--------------------Evaluators---------------------*/
+
+//bigger towards the edges
+int push_to_edge(const Square s) {
+    return 10 * (std::abs(2 * file_of(s) - 7) + std::abs(2 * rank_of(s) - 7));
+}
+
+//bigger towards the corners the bishop can reach
+int push_to_corner(const Square s, const bool dark) {
+    const int f = file_of(s), r = rank_of(s);
+    const int d = dark ? std::min(f + r, 14 - f - r)
+                       : std::min(f + 7 - r, 7 - f + r);
+    return 40 * (7 - d);
+}
+
+int push_close(const Square s1, const Square s2) {
+    return 20 * (7 - distance(s1, s2));
+}
+
+bool stalemated(const Board &b, const Color weak) {
+    return b.side_to_move() == weak && !b.checkers() && !has_legal_move(b);
+}
+
+//KQK and KRK: drive the king to the edge
+int eval_kxk(const Board &b, const Color strong) {
+    const Color weak = ~strong;
+    if (stalemated(b, weak))
+        return 0;
+
+    const Square sk = b.king_square(strong), wk = b.king_square(weak);
+    const int material = b.pieces(strong, QUEEN) ? eg_value[QUEEN] : eg_value[ROOK];
+    return KNOWN_WIN + material + push_to_edge(wk) + push_close(sk, wk);
+}
+
+//the mate is only possible in a corner of the bishop's colour
+int eval_kbnk(const Board &b, const Color strong) {
+    const Color weak = ~strong;
+    if (stalemated(b, weak))
+        return 0;
+
+    const Square sk = b.king_square(strong), wk = b.king_square(weak);
+    const bool dark = b.pieces(strong, BISHOP) & DARK_SQUARES;
+    return KNOWN_WIN + eg_value[BISHOP] + eg_value[KNIGHT]
+        + push_to_corner(wk, dark) + push_close(sk, wk);
+}
+
+int eval_kpk(const Board &b, const Color strong) {
+    Square wksq = relative_square(strong, b.king_square(strong)),
+           bksq = relative_square(strong, b.king_square(~strong)),
+           psq = relative_square(strong, lsb(b.pieces(strong, PAWN)));
+
+    if (file_of(psq) >= FILE_E) {
+        wksq = static_cast<Square>(wksq ^ 7);
+        bksq = static_cast<Square>(bksq ^ 7);
+        psq = static_cast<Square>(psq ^ 7);
+    }
+
+    const Color stm = b.side_to_move() == strong ? WHITE : BLACK;
+    if (!kpk_probe(stm, wksq, psq, bksq))
+        return 0;
+
+    return KNOWN_WIN + eg_value[PAWN] + 10 * rank_of(psq);
+}
+
+/*
+ * Seen from the rook's side, the pawn goes down the board.
+ * Won if our king blocks the pawn or theirs is too far away,
+ * otherwise the score depends on the race to the queening square.
+ * */
+int eval_krkp(const Board &b, const Color strong) {
+    const Color weak = ~strong;
+    const Square wksq = relative_square(strong, b.king_square(strong)),
+                 bksq = relative_square(strong, b.king_square(weak)),
+                 rsq = relative_square(strong, lsb(b.pieces(strong, ROOK))),
+                 psq = relative_square(strong, lsb(b.pieces(weak, PAWN)));
+
+    const Square queening = make_square(file_of(psq), RANK_1);
+    const Square stop = sq_shift<SOUTH>(psq);
+    const Color stm = b.side_to_move();
+
+    if (file_of(wksq) == file_of(psq) && rank_of(wksq) < rank_of(psq))
+        return eg_value[ROOK] - distance(wksq, psq);
+
+    if (distance(bksq, psq) >= 3 + (stm == weak) && distance(bksq, rsq) >= 3)
+        return eg_value[ROOK] - distance(wksq, psq);
+
+    if (rank_of(bksq) <= RANK_3 && distance(bksq, psq) == 1
+            && rank_of(wksq) >= RANK_4 && distance(wksq, psq) > 2 + (stm == strong))
+        return 80 - 8 * distance(wksq, psq);
+
+    return 200 - 8 * (distance(wksq, stop) - distance(bksq, stop)
+        - distance(psq, queening));
+}
+
+//only bishops and pawns, the bishops on opposite colours
+int scale_ocb(const Board &b, const Color strong) {
+    const Bitboard bishops = b.pieces(BISHOP);
+    if (!(bishops & DARK_SQUARES) || !(bishops & ~DARK_SQUARES))
+        return SCALE_NORMAL;
+
+    const int extra = popcnt(b.pieces(strong, PAWN))
+        - popcnt(b.pieces(~strong, PAWN));
+    return std::clamp(16 + 16 * extra, 16, SCALE_NORMAL);
+}
+
+/*-----------------End of evaluators-----------------*/
+
+//returns a score for the stronger side
+using EvalFn = int (*)(const Board &b, Color strong);
+//returns a factor out of SCALE_NORMAL
+using ScaleFn = int (*)(const Board &b, Color strong);
+
+struct Endgame {
+    EvalFn fn;
+    Color strong;
+};
+
+std::unordered_map<uint64_t, Endgame> EVALUATORS;
+//keyed by the material key without pawns
+std::unordered_map<uint64_t, ScaleFn> SCALERS;
+
+void add(const uint64_t white_key, const uint64_t black_key, const EvalFn fn) {
+    EVALUATORS[white_key] = { fn, WHITE };
+    EVALUATORS[black_key] = { fn, BLACK };
+}
+
+//every registered ending has at most two pieces besides kings and pawns
+bool few_pieces(const Board &b) {
+    return popcnt(b.pieces() ^ b.pieces(PAWN)) <= 4;
+}
+
+} //namespace
+
+void init_endgames() {
+    init_kpk();
+
+    add(pckey_v<W_PAWN>, pckey_v<B_PAWN>, eval_kpk);
+    add(pckey_v<W_QUEEN>, pckey_v<B_QUEEN>, eval_kxk);
+    add(pckey_v<W_ROOK>, pckey_v<B_ROOK>, eval_kxk);
+    add(pckey_v<W_BISHOP, W_KNIGHT>, pckey_v<B_BISHOP, B_KNIGHT>, eval_kbnk);
+    add(pckey_v<W_ROOK, B_PAWN>, pckey_v<B_ROOK, W_PAWN>, eval_krkp);
+
+    SCALERS[pckey_v<W_BISHOP, B_BISHOP>] = scale_ocb;
+}
+
+bool kpk_probe(const Color stm, const Square wksq,
+        const Square wpsq, const Square bksq)
+{
+    assert(file_of(wpsq) <= FILE_D);
+    const int idx = kpk_index(stm, bksq, wksq, wpsq);
+    return KPK_BITBASE[idx / 32] & (1u << (idx & 31));
+}
+
+bool endgame_eval(const Board &b, int &score) {
+    if (!few_pieces(b))
+        return false;
+
+    const auto it = EVALUATORS.find(b.mat_key());
+    if (it == EVALUATORS.end())
+        return false;
+
+    const auto [fn, strong] = it->second;
+    const int v = fn(b, strong);
+    score = b.side_to_move() == strong ? v : -v;
+    return true;
+}
+
+int endgame_scale(const Board &b, const int eval) {
+    if (!few_pieces(b))
+        return eval;
+
+    const auto it = SCALERS.find(b.mat_key() & ~PAWNS_KEY_MASK);
+    if (it == SCALERS.end())
+        return eval;
+
+    const Color strong = eval >= 0 ? b.side_to_move() : ~b.side_to_move();
+    return eval * it->second(b, strong) / SCALE_NORMAL;
+}
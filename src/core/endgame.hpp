@@ -0,0 +1,32 @@
+#ifndef ENDGAME_HPP
+#define ENDGAME_HPP
+
+#include "../primitives/common.hpp"
+
+//won, but not a mate score; what the endgame evaluators return on top of
+constexpr int KNOWN_WIN = 10000;
+
+class Board;
+
+/*
+ * Specialised evaluation of a few endings, looked up by Board::mat_key().
+ * An evaluator replaces the NNUE output (KPK, KBNK, KRKP, KQK and KRK),
+ * a scaling function only shrinks it towards a draw
+ * (opposite coloured bishops).
+ * */
+
+//generates the KPK bitbase and fills the tables
+void init_endgames();
+
+//Probes the KPK bitbase, the pawn is white and on files A-D.
+//Returns true if white wins
+[[nodiscard]] bool kpk_probe(Color stm, Square wksq, Square wpsq, Square bksq);
+
+//Sets score (from the side to move's point of view)
+//and returns true if the material has an evaluator
+bool endgame_eval(const Board &b, int &score);
+
+//eval scaled towards zero if the material is drawish
+[[nodiscard]] int endgame_scale(const Board &b, int eval);
+
+#endif
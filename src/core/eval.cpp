@@ -1,6 +1,8 @@
 #include "eval.hpp"
+#include "endgame.hpp"
 #include "../board/board.hpp"
 #include "../nnue/nnue.h"
+#include <algorithm>
 
 //Copypasted from
 //https://www.chessprogramming.org/PeSTO%27s_Evaluation_Function
@@ -140,10 +142,6 @@ constexpr int16_t eg_king_table[64] = {
     -53, -34, -21, -11, -28, -14, -24, -43
 };
 
-[[maybe_unused]] constexpr int16_t gamephaseInc[PIECE_TYPE_NB] = {
-    0, 0, 1, 1, 2, 4, 0
-};
-
 int16_t mg_table[PIECE_TYPE_NB][SQUARE_NB];
 int16_t eg_table[PIECE_TYPE_NB][SQUARE_NB];
 
@@ -168,6 +166,14 @@ void init_ps_tables() {
         }
     }
 }
+
+int16_t mg_pst(const PieceType pt, const Square sq) {
+    return mg_table[pt][sq];
+}
+
+int16_t eg_pst(const PieceType pt, const Square sq) {
+    return eg_table[pt][sq];
+}
 /*
 int16_t evaluate(const Board &b) {
     Color us = b.side_to_move(), them = ~us;
@@ -239,85 +245,33 @@ wking = 1, wqueen = 2,wrook = 3, wbishop = 4, wknight = 5,wpawn = 6,
 bking = 7, bqueen = 8, brook = 9, bbishop = 10, bknight = 11, bpawn = 12,
 */
 
-// builds pieces & squares arrays as required by nnue specs above
-int eval_nnue(const Board& pos)
+// builds pieces & squares arrays as required by nnue specs above,
+// with room for 33 entries. Pieces go by square after the kings,
+// walking the occupancy instead of testing every square
+void nnue_arrays(const Board& pos, int* pieces, int* squares)
 {
-    int pieces[33]{};
-    int squares[33]{};
+    constexpr int nnue_piece[PIECE_NB] = { 0, 6, 5, 4, 3, 2, 1, 0, 0, 12, 11, 10, 9, 8, 7 };
+
+    pieces[0] = 1;
+    squares[0] = lsb(pos.pieces(WHITE, KING));
+    pieces[1] = 7;
+    squares[1] = lsb(pos.pieces(BLACK, KING));
+
     int index = 2;
-    for (uint8_t i = 0; i < 64; i++)
+    for (Bitboard bb = pos.pieces() & ~pos.pieces(KING); bb; index++)
     {
-        if (pos.piece_on(static_cast<Square>(i)) == 6)
-        {
-            pieces[0] = 1;
-            squares[0] = i;
-        }
-        else if (pos.piece_on(static_cast<Square>(i)) == 14)
-        {
-            pieces[1] = 7;
-            squares[1] = i;
-        }
-        else if (pos.piece_on(static_cast<Square>(i)) == 1)
-        {
-            pieces[index] = 6;
-            squares[index] = i;
-            index++;
-        }
-        else if (pos.piece_on(static_cast<Square>(i)) == 2)
-        {
-            pieces[index] = 5;
-            squares[index] = i;
-            index++;
-        }
-        else if (pos.piece_on(static_cast<Square>(i)) == 3)
-        {
-            pieces[index] = 4;
-            squares[index] = i;
-            index++;
-        }
-        else if (pos.piece_on(static_cast<Square>(i)) == 4)
-        {
-            pieces[index] = 3;
-            squares[index] = i;
-            index++;
-        }
-        else if (pos.piece_on(static_cast<Square>(i)) == 5)
-        {
-            pieces[index] = 2;
-            squares[index] = i;
-            index++;
-        }
-        else if (pos.piece_on(static_cast<Square>(i)) == 9)
-        {
-            pieces[index] = 12;
-            squares[index] = i;
-            index++;
-        }
-        else if (pos.piece_on(static_cast<Square>(i)) == 10)
-        {
-            pieces[index] = 11;
-            squares[index] = i;
-            index++;
-        }
-        else if (pos.piece_on(static_cast<Square>(i)) == 11)
-        {
-            pieces[index] = 10;
-            squares[index] = i;
-            index++;
-        }
-        else if (pos.piece_on(static_cast<Square>(i)) == 12)
-        {
-            pieces[index] = 9;
-            squares[index] = i;
-            index++;
-        }
-        else if (pos.piece_on(static_cast<Square>(i)) == 13)
-        {
-            pieces[index] = 8;
-            squares[index] = i;
-            index++;
-        }
+        const Square s = pop_lsb(bb);
+        pieces[index] = nnue_piece[pos.piece_on(s)];
+        squares[index] = s;
     }
+    pieces[index] = 0;
+}
+
+int eval_nnue(const Board& pos)
+{
+    int pieces[33]{};
+    int squares[33]{};
+    nnue_arrays(pos, pieces, squares);
 
     const int nnue_score = nnue_evaluate(pos.side_to_move(), pieces, squares);
     return nnue_score;
@@ -325,6 +279,42 @@ int eval_nnue(const Board& pos)
 
 int16_t evaluate(const Board& pos)
 {
-    const int nnue_score = eval_nnue(pos);
+    if (int score; endgame_eval(pos, score))
+        return static_cast<int16_t>(score);
+
+    const int nnue_score = endgame_scale(pos, eval_nnue(pos));
     return static_cast<int16_t>(nnue_score);
-}
\ No newline at end of file
+}
+
+void evaluate_batch(const Board* pos, const size_t n, int16_t* out)
+{
+    //the nnue gets the positions in chunks small enough for the stack
+    constexpr size_t CHUNK = 64;
+    int pieces[CHUNK][33], squares[CHUNK][33];
+    int *piece_ptrs[CHUNK], *square_ptrs[CHUNK];
+    int players[CHUNK], scores[CHUNK];
+    size_t batched[CHUNK];
+
+    for (size_t first = 0; first < n; first += CHUNK)
+    {
+        int count = 0;
+        for (size_t i = first; i < std::min(n, first + CHUNK); i++)
+        {
+            if (int score; endgame_eval(pos[i], score))
+            {
+                out[i] = static_cast<int16_t>(score);
+                continue;
+            }
+            nnue_arrays(pos[i], pieces[count], squares[count]);
+            piece_ptrs[count] = pieces[count];
+            square_ptrs[count] = squares[count];
+            players[count] = pos[i].side_to_move();
+            batched[count++] = i;
+        }
+
+        nnue_evaluate_batch(count, players, piece_ptrs, square_ptrs, scores);
+
+        for (int j = 0; j < count; j++)
+            out[batched[j]] = static_cast<int16_t>(endgame_scale(pos[batched[j]], scores[j]));
+    }
+}
@@ -2,15 +2,26 @@
 #define EVAL_HPP
 
 #include "../primitives/common.hpp"
+#include <cstddef>
 
 constexpr int mg_value[PIECE_TYPE_NB] = { 0, 82, 337, 365, 477, 1025,  0};
 constexpr int eg_value[PIECE_TYPE_NB] = { 0, 94, 281, 297, 512,  936,  0};
 
 constexpr int ENDGAME_MAT = mg_value[QUEEN] + mg_value[BISHOP];
 
+//24 with all minor and major pieces on the board
+constexpr int gamephaseInc[PIECE_TYPE_NB] = { 0, 0, 1, 1, 2, 4, 0 };
+
 class Board;
 
 void init_ps_tables();
+//material plus PeSTO square values once init_ps_tables() ran. Squares are
+//seen from black's side (rank 8 first), white pieces look up sq ^ 56
+int16_t mg_pst(PieceType pt, Square sq);
+int16_t eg_pst(PieceType pt, Square sq);
 int16_t evaluate(const Board &pos);
+//evaluate() of n positions, faster when neighbours are related
+//(children of a node, positions of a game in order)
+void evaluate_batch(const Board *pos, size_t n, int16_t *out);
 
 #endif
@@ -5,6 +5,7 @@
 #include <condition_variable>
 #include <thread>
 #include <atomic>
+#include <chrono>
 #include <functional>
 
 class Routine {
@@ -26,6 +27,7 @@ public:
                 if (go_.load(std::memory_order_relaxed))
                     f();
                 go_.store(false, std::memory_order_relaxed);
+                done_cv_.notify_all();
             }
         });
     }
@@ -39,8 +41,11 @@ public:
         cv_.notify_one();
     }
 
+    //f() may never start after a pause() that follows resume(),
+    //so a wait_for_completion() already waiting is woken here
     void pause() {
         go_.store(false, std::memory_order_relaxed);
+        done_cv_.notify_all();
     }
 
     void terminate() {
@@ -49,8 +54,16 @@ public:
         cv_.notify_one();
     }
 
+    //Blocks until f() has returned, even if resume() was called
+    //and the worker thread has not picked the task up yet
     void wait_for_completion() {
-        std::lock_guard lck(mutex_);
+        std::unique_lock lck(mutex_);
+        //pause() runs on the search thread too, which holds mutex_,
+        //so it notifies unlocked and the wait polls against a lost wakeup
+        while (!done_cv_.wait_for(lck, std::chrono::milliseconds(1), [this]
+        {
+            return !go_.load(std::memory_order_relaxed);
+        }));
     }
 
     void join() {
@@ -66,7 +79,7 @@ public:
 private:
     std::thread thread_;
     std::mutex mutex_;
-    std::condition_variable cv_;
+    std::condition_variable cv_, done_cv_;
 
     std::atomic_bool go_;
     std::atomic_bool terminate_;
@@ -5,13 +5,60 @@
 #include <chrono>
 #include "../primitives/common.hpp"
 
+#if !defined(NDEBUG) || defined(ABLATION)
+#define RUNTIME_FEATURES
+#endif
+
+//Search techniques that can be switched off for ablation runs
+enum SearchFeature : uint8_t {
+    FEAT_NMP,
+    FEAT_RFP,
+    FEAT_LMP,
+    FEAT_LMR,
+    FEAT_IIR,
+    FEAT_DELTA,
+    FEAT_ASPIRATION,
+    FEAT_KILLERS,
+    FEAT_COUNTERS,
+
+    FEATURE_NB,
+};
+
+constexpr const char *FEATURE_NAMES[FEATURE_NB] = {
+    "nmp", "rfp", "lmp", "lmr", "iir",
+    "delta", "aspiration", "killers", "counters",
+};
+
+/*
+ * Debug (or ABLATION) builds can toggle every feature at runtime.
+ * Release builds only see the constexpr policy, so the disabled
+ * branches are folded away and cost nothing.
+ * */
+struct SearchFeatures {
+#ifdef RUNTIME_FEATURES
+    uint16_t mask = (1 << FEATURE_NB) - 1;
+
+    [[nodiscard]] bool enabled(const SearchFeature f) const {
+        return (mask >> f) & 1;
+    }
+
+    void set(const SearchFeature f, const bool on) {
+        mask = static_cast<uint16_t>((mask & ~(1 << f)) | (on << f));
+    }
+#else
+    static constexpr bool enabled(const SearchFeature) { return true; }
+    static constexpr void set(const SearchFeature, const bool) {}
+#endif
+};
+
 struct SearchStats {
     uint64_t nodes{}, qnodes{};
     uint64_t fail_high{}, fail_high_first{};
+    uint64_t tb_hits{};
     int sel_depth{};
 
     void reset() {
-        nodes = qnodes = fail_high = fail_high_first = 0;
+        nodes = qnodes = fail_high = fail_high_first = tb_hits = 0;
         sel_depth = 0;
     }
 };
@@ -26,11 +73,23 @@ namespace timer {
     }
 }
 
+//Cumulative counters at the end of a completed iteration
+struct IterationStats {
+    int depth, score;
+    uint64_t nodes;
+    uint64_t fail_high, fail_high_first;
+    TimePoint time;
+};
+
 struct SearchLimits {
     int max_depth = MAX_DEPTH;
     int time[2]{}, inc[2]{};
     int move_time{};
     bool infinite{};
+    bool until_stop{}; //"go infinite", bestmove waits for "stop"
+    bool silent{}; //no info/bestmove output
+    int mate{};    //moves, "go mate N"
+    uint64_t nodes{};
 
     TimePoint start{};
 };
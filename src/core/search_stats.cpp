@@ -0,0 +1,85 @@
+#include "search_stats.hpp"
+
+#ifdef SEARCH_STATS
+
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+
+namespace {
+
+constexpr const char *STAGE_NAMES[SearchCounters::STAGE_NB] = {
+    "tt_move", "init_tactical", "good_tactical",
+    "killer_1", "killer_2", "counter_move", "follow_up",
+    "bad_tactical", "init_nontactical", "non_tactical",
+};
+
+template<size_t N>
+void json_array(std::ostream &os, const uint64_t (&arr)[N], size_t n = N) {
+    os << '[';
+    for (size_t i = 0; i < n; ++i)
+        os << (i ? ", " : "") << arr[i];
+    os << ']';
+}
+
+} //namespace
+
+void SearchCounters::reset() {
+    memset(this, 0, sizeof(SearchCounters));
+}
+
+void SearchCounters::add_cutoff(const int index, const Stage st) {
+    cutoff_index[std::min(index, INDEX_NB - 1)]++;
+    cutoff_stage[static_cast<int>(st)]++;
+}
+
+void SearchCounters::info(std::ostream &os) const {
+    os << "info string stats tt_cutoffs " << tt_cutoffs
+       << " nmp " << nmp_cutoffs << '/' << nmp_tries
+       << " rfp " << rfp_cutoffs
+       << " lmp " << lmp_skips
+       << " lmr_researches " << lmr_researches << '/' << lmr_searches
+       << '\n';
+
+    os << "info string stats asp_researches";
+    for (int d = 0; d < DEPTH_NB; ++d)
+        if (asp_researches[d])
+            os << ' ' << d << ':' << asp_researches[d];
+    os << '\n';
+
+    os << "info string stats cutoff_index";
+    for (int i = 0; i < INDEX_NB; ++i)
+        os << ' ' << cutoff_index[i];
+    os << '\n';
+
+    os << "info string stats cutoff_stage";
+    for (int i = 0; i < STAGE_NB; ++i)
+        if (cutoff_stage[i])
+            os << ' ' << STAGE_NAMES[i] << ':' << cutoff_stage[i];
+    os << '\n';
+}
+
+void SearchCounters::json(std::ostream &os) const {
+    int last_depth = DEPTH_NB;
+    while (last_depth > 0 && !asp_researches[last_depth - 1])
+        --last_depth;
+
+    os << "{\"tt_cutoffs\": " << tt_cutoffs << ",\n"
+       << "\"nmp_tries\": " << nmp_tries << ",\n"
+       << "\"nmp_cutoffs\": " << nmp_cutoffs << ",\n"
+       << "\"rfp_cutoffs\": " << rfp_cutoffs << ",\n"
+       << "\"lmp_skips\": " << lmp_skips << ",\n"
+       << "\"lmr_searches\": " << lmr_searches << ",\n"
+       << "\"lmr_researches\": " << lmr_researches << ",\n"
+       << "\"asp_researches\": ";
+    json_array(os, asp_researches, last_depth);
+    os << ",\n\"cutoff_index\": ";
+    json_array(os, cutoff_index);
+    os << ",\n\"cutoff_stage\": {";
+    for (int i = 0; i < STAGE_NB; ++i)
+        os << (i ? ", " : "") << '"' << STAGE_NAMES[i]
+           << "\": " << cutoff_stage[i];
+    os << "}}\n";
+}
+
+#endif
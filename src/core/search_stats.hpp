@@ -0,0 +1,48 @@
+#ifndef SEARCH_STATS_HPP
+#define SEARCH_STATS_HPP
+
+/*
+ * Search instrumentation, enabled with SEARCH_STATS
+ * (make stats=yes, cmake -DSEARCH_STATS=ON).
+ * Without it the counters and every STATS(...) statement
+ * are compiled out.
+ * */
+#ifdef SEARCH_STATS
+#define STATS(x) x
+#else
+#define STATS(x)
+#endif
+
+#ifdef SEARCH_STATS
+
+#include <cstdint>
+#include <iosfwd>
+#include "../movepicker.hpp"
+
+struct SearchCounters {
+    //cutoffs on move 16 and later share the last bucket
+    static constexpr int INDEX_NB = 16;
+    static constexpr int STAGE_NB = static_cast<int>(Stage::NON_TACTICAL) + 1;
+    //iterations run up to and including max_depth == MAX_DEPTH
+    static constexpr int DEPTH_NB = MAX_DEPTH + 1;
+
+    uint64_t tt_cutoffs;
+    uint64_t nmp_tries, nmp_cutoffs;
+    uint64_t rfp_cutoffs;
+    uint64_t lmp_skips;
+    uint64_t lmr_searches, lmr_researches;
+    uint64_t asp_researches[DEPTH_NB];
+    uint64_t cutoff_index[INDEX_NB];
+    uint64_t cutoff_stage[STAGE_NB];
+
+    void reset();
+    void add_cutoff(int index, Stage st);
+
+    //a few "info string" lines
+    void info(std::ostream &os) const;
+    void json(std::ostream &os) const;
+};
+
+#endif
+
+#endif
@@ -5,10 +5,13 @@
 #include "../primitives/utility.hpp"
 #include "../tree.hpp"
 #include "../tt.hpp"
+#include "../syzygy/tbprobe.hpp"
 #include <algorithm>
+#include <chrono>
 #include <sstream>
 #include <cstring>
 #include <cmath>
+#include <thread>
 
 #ifdef _MSC_VER
 #else
@@ -17,7 +20,6 @@
 
 namespace {
 
-constexpr bool DO_NMP = true;
 uint8_t LMR[32][64];
 
 bool can_return_ttscore(const TTEntry &tte, 
@@ -53,6 +55,35 @@ int16_t cap_value(const Board &b, const Move m) {
     return mg_value[type_of(b.piece_on(to_sq(m)))];
 }
 
+#ifdef SEARCH_STATS
+//the stage MovePicker returned a move from
+Stage stage_of(const Board &b, const Move m, const Move ttm,
+        const Move *killers, const Move counter, const Move followup)
+{
+    if (m == ttm) return Stage::TT_MOVE;
+    if (!b.is_quiet(m)) 
+        return b.see_ge(m) ? Stage::GOOD_TACTICAL : Stage::BAD_TACTICAL;
+    if (killers && m == killers[0]) return Stage::KILLER_1;
+    if (killers && m == killers[1]) return Stage::KILLER_2;
+    if (m == counter) return Stage::COUNTER_MOVE;
+    if (m == followup) return Stage::FOLLOW_UP;
+    return Stage::NON_TACTICAL;
+}
+#endif
+
+//score shown for a root move ranked by syzygy::rank_root_moves
+int tb_root_score(const syzygy::RankedMove &m) {
+    if (m.rank >= 900)
+        return VALUE_TB_WIN - m.dtz;
+    if (m.rank > 0)
+        return std::max(3, m.rank - 800) * mg_value[PAWN] / 200;
+    if (m.rank == 0)
+        return 0;
+    if (m.rank > -900)
+        return std::min(-3, m.rank + 800) * mg_value[PAWN] / 200;
+    return -VALUE_TB_WIN - m.dtz;
+}
+
 } //namespace
 
 void init_reduction_tables() {
@@ -64,9 +95,9 @@ void init_reduction_tables() {
     LMR[0][0] = LMR[0][1] = LMR[1][0] = 0;
 }
 
-void RootMovePicker::reset(const Board &root){
+void RootMovePicker::reset(const Board &root, const TranspositionTable &tt){
     Move ttm = MOVE_NONE;
-    if (TTEntry tte{}; g_tt.probe(root.key(), tte)) {
+    if (TTEntry tte{}; tt.probe(root.key(), tte)) {
         if (!root.is_valid_move(ttm = static_cast<Move>(tte.move16)))
             ttm = MOVE_NONE;
     }
@@ -102,6 +133,35 @@ int RootMovePicker::num_moves() const {
     return num_moves_;
 }
 
+bool RootMovePicker::rank_by_dtz(const Board &root, Stack &st, int &score) {
+    if (!num_moves_ || root.castling()
+            || popcnt(root.pieces()) > syzygy::max_pieces())
+        return false;
+
+    std::array<syzygy::RankedMove, MAX_MOVES> ranked;
+    for (int i = 0; i < num_moves_; ++i)
+        ranked[i] = { moves_[i].move, 0, 0 };
+    if (!syzygy::rank_root_moves(root, st, ranked.data(), num_moves_))
+        return false;
+
+    std::stable_sort(ranked.begin(), ranked.begin() + num_moves_,
+        [](const syzygy::RankedMove &x, const syzygy::RankedMove &y)
+    {
+        if (x.rank != y.rank) return x.rank > y.rank;
+        return x.dtz < y.dtz;
+    });
+
+    int n = 0;
+    while (n < num_moves_ && ranked[n].rank == ranked[0].rank) {
+        moves_[n] = { ranked[n].move, 0, 0, 0 };
+        ++n;
+    }
+    num_moves_ = n;
+    score = tb_root_score(ranked[0]);
+
+    return true;
+}
+
 void RootMovePicker::complete_iter() {
     std::sort(moves_.begin(), moves_.begin() + num_moves_,
         [](const RootMove &x, const RootMove &y)
@@ -113,9 +173,16 @@ void RootMovePicker::complete_iter() {
 }
 
 SearchWorker::SearchWorker() 
-    : root_(Board::start_pos())
+    : root_(Board::start_pos()),
+      tt_(&g_tt),
+      hist_(std::make_unique<Histories>())
 {
-    loop_.start([this] { iterative_deepening(); });
+    loop_.start([this]
+    {
+        iterative_deepening();
+        if (on_done_)
+            on_done_(best_);
+    });
 }
 
 void SearchWorker::go(const Board &root, const Stack &st, 
@@ -130,15 +197,70 @@ void SearchWorker::go(const Board &root, const Stack &st,
     man_.start = limits.start;
     man_.max_time = limits_.move_time;
     stats_.reset();
-    rmp_.reset(root_);
-    hist_.reset();
+    STATS(instr_.reset());
+    iters_.clear();
+    tree_.clear();
+    rmp_.reset(root_, *tt_);
+    hist_->age();
+
+    //the root moves already keep the result, probing in search
+    //would only hide the differences between them
+    tb_score_ = 0;
+    tb_pieces_ = 0;
+#ifdef TB_SEARCH
+    tb_pieces_ = syzygy::max_pieces();
+    if (const int n = rmp_.num_moves(); rmp_.rank_by_dtz(root_, stack_, tb_score_)) {
+        tb_pieces_ = 0;
+        tb_move_ = rmp_.first();
+        stats_.tb_hits += n;
+    }
+#endif
 
     man_.init(limits, root.side_to_move(), st.total_height());
 
+    loop_.resume();
+}
+
+void SearchWorker::new_game() {
+    loop_.pause();
+    loop_.wait_for_completion();
+
+    hist_->reset();
     memset(counters_.data(), 0, sizeof(counters_));
     memset(followups_.data(), 0, sizeof(followups_));
+}
 
-    loop_.resume();
+SearchFeatures &SearchWorker::features() {
+    return features_;
+}
+
+void SearchWorker::set_tt(TranspositionTable &tt) {
+    tt_ = &tt;
+}
+
+const std::vector<IterationStats> &SearchWorker::iterations() const {
+    return iters_;
+}
+
+Tree &SearchWorker::tree() {
+    return tree_;
+}
+
+#ifdef SEARCH_STATS
+const SearchCounters &SearchWorker::counters() const {
+    return instr_;
+}
+#endif
+
+Move SearchWorker::best_move() const {
+    return best_;
+}
+
+void SearchWorker::set_callbacks(IterationCallback on_iteration, DoneCallback on_done) {
+    loop_.pause();
+    loop_.wait_for_completion();
+    on_iteration_ = std::move(on_iteration);
+    on_done_ = std::move(on_done);
 }
 
 void SearchWorker::stop() {
@@ -152,18 +274,26 @@ void SearchWorker::wait_for_completion() {
 void SearchWorker::check_time() {
     if (stats_.nodes & 2047)
         return;
-    if (loop_.keep_going() && !limits_.infinite
-            && man_.out_of_time())
+    if (loop_.keep_going() && ((!limits_.infinite && man_.out_of_time())
+            || (limits_.nodes && stats_.nodes >= limits_.nodes)))
         loop_.pause();
 }
 
+void SearchWorker::hold_until_stop() const {
+    while (limits_.until_stop && loop_.keep_going())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
 void SearchWorker::iterative_deepening() {
     Move pv[MAX_DEPTH]{};
     int pv_len = 0, score = 0, ebf = 1;
     std::ostringstream ss;
 
+    best_ = rmp_.first();
     if (rmp_.num_moves() == 1 || is_draw()) {
-        sync_cout() << "bestmove " << rmp_.first() << '\n';
+        hold_until_stop();
+        if (!limits_.silent)
+            sync_cout() << "bestmove " << rmp_.first() << '\n';
         return;
     }
 
@@ -171,19 +301,36 @@ void SearchWorker::iterative_deepening() {
 	    const auto elapsed = timer::now() - limits_.start;
 	    const uint64_t nps = stats_.nodes * 1000 / (elapsed + 1);
 
-        if (pv_len = g_tt.extract_pv(root_, pv, d); !pv_len) {
+        if (pv_len = tt_->extract_pv(root_, pv, d); !pv_len) {
             pv_len = 1;
             pv[0] = rmp_.first();
         }
+        //a won root is converted by DTZ until the search sees the mate,
+        //the moves searched all keep the win but may not make progress
+        int shown = score;
+        if (tb_score_ > MATE_BOUND && score < MATE_BOUND) {
+            pv_len = 1;
+            pv[0] = tb_move_;
+            shown = tb_score_;
+        }
+        best_ = pv[0];
+
+        iters_.push_back({ d, shown, stats_.nodes, stats_.fail_high,
+            stats_.fail_high_first, elapsed });
+        if (on_iteration_)
+            on_iteration_(iters_.back(), pv, pv_len);
+        if (limits_.silent)
+            return;
 
         ss.str("");
         ss.clear();
 	    const float fhf = stats_.fail_high_first 
             / static_cast<float>(stats_.fail_high + 1);
-        ss << "info score " << Score{score}
+        ss << "info score " << Score{shown}
            << " depth " << d
            << " seldepth " << stats_.sel_depth
            << " nodes " << stats_.nodes
+           << " tbhits " << stats_.tb_hits
            << " time " << elapsed
            << " nps " << nps
            << " fhf " << fhf
@@ -200,7 +347,7 @@ void SearchWorker::iterative_deepening() {
     uint64_t nodes = stats_.nodes;
     report(1);
     for (int d = 2; d <= limits_.max_depth; ++d) {
-        g_tree.clear();
+        tree_.clear();
         prev_nodes = nodes;
         const uint64_t before = stats_.nodes;
         const int prev_score = score;
@@ -222,11 +369,21 @@ void SearchWorker::iterative_deepening() {
         if (abs(score) >= VALUE_MATE - d)
             break;
     }
+    hold_until_stop();
+    if (limits_.silent)
+        return;
+
+#ifdef SEARCH_STATS
+    ss.str("");
+    ss.clear();
+    instr_.info(ss);
+    sync_cout() << ss.str();
+#endif
     sync_cout() << "bestmove " << pv[0] << '\n';
 }
 
 int SearchWorker::aspriration_window(int score, const int depth) {
-    if (depth <= 5)
+    if (depth <= 5 || !features_.enabled(FEAT_ASPIRATION))
         return search_root(-VALUE_MATE, VALUE_MATE, depth);
 
     int delta = 16, alpha = score - delta, 
@@ -236,6 +393,7 @@ int SearchWorker::aspriration_window(int score, const int depth) {
         if (beta >= 3000) beta = VALUE_MATE;
 
         score = search_root(alpha, beta, depth);
+        STATS(instr_.asp_researches[depth] += score <= alpha || score >= beta);
 
         if (score <= alpha) {
             beta = (alpha + beta) / 2;
@@ -253,9 +411,11 @@ int SearchWorker::aspriration_window(int score, const int depth) {
 }
 
 int SearchWorker::search_root(int alpha, const int beta, const int depth) {
-	if (TTEntry tte{}; g_tt.probe(root_.key(), tte)) {
-        if (can_return_ttscore(tte, alpha, beta, depth, 0))
+	if (TTEntry tte{}; tt_->probe(root_.key(), tte)) {
+        if (can_return_ttscore(tte, alpha, beta, depth, 0)) {
+            STATS(instr_.tt_cutoffs++);
             return alpha;
+        }
         if (auto ttm = static_cast<Move>(tte.move16); !root_.is_valid_move(ttm))
             ttm = MOVE_NONE;
     }
@@ -267,9 +427,9 @@ int SearchWorker::search_root(int alpha, const int beta, const int depth) {
 	Board bb{};
     for (Move m = rmp_.next(); m != MOVE_NONE; m = rmp_.next()) {
 	    const uint64_t nodes_before = stats_.nodes;
-	    const size_t ndx = Tree::begin_node(m, alpha, beta, depth - 1, 0);
+	    const size_t ndx = tree_.begin_node(m, alpha, beta, depth - 1, 0);
         bb = root_.do_move(m);
-        stack_.push(root_.key(), m);
+        stack_.push(root_.key(), m, 0, root_.piece_on(from_sq(m)));
 
         int score;
         if (!moves_tried) {
@@ -282,7 +442,7 @@ int SearchWorker::search_root(int alpha, const int beta, const int depth) {
 
         ++moves_tried;
         stack_.pop();
-	    Tree::end_node(ndx, static_cast<int16_t>(score));
+	    tree_.end_node(ndx, static_cast<int16_t>(score));
         rmp_.update_last(score, stats_.nodes - nodes_before);
 
         if (score > best_score) {
@@ -300,7 +460,7 @@ int SearchWorker::search_root(int alpha, const int beta, const int depth) {
     
     rmp_.complete_iter();
     if (loop_.keep_going()) {
-        g_tt.store(TTEntry(root_.key(), alpha, 
+        tt_->store(TTEntry(root_.key(), alpha, 
             determine_bound(alpha, beta, old_alpha),
             depth, best_move, 0, false));
     }
@@ -333,91 +493,153 @@ int SearchWorker::search(const Board &b, int alpha,
     stats_.sel_depth = std::max(stats_.sel_depth, ply);
 
     auto &entry = stack_.at(ply);
-    g_tt.prefetch(b.key());
+    tt_->prefetch(b.key());
     if (b.half_moves() >= 100 
         || (!b.checkers() && b.is_material_draw())
         || stack_.is_repetition(b))
         return 0;
 
+    //either side can force a draw by repetition with its next move
+    if (alpha < 0 && stack_.has_upcoming_repetition(b)) {
+        alpha = 0;
+        if (alpha >= beta)
+            return alpha;
+    }
+
     TTEntry tte{};
     bool avoid_null = false;
     Move ttm = MOVE_NONE;
-    if (g_tt.probe(b.key(), tte)) {
+    if (tt_->probe(b.key(), tte)) {
         if (ttm = static_cast<Move>(tte.move16); !b.is_valid_move(ttm))
             ttm = MOVE_NONE;
         
         if (can_return_ttscore(tte, alpha, beta, 
                     depth, ply))
         {
+            STATS(instr_.tt_cutoffs++);
             if (ttm && b.is_quiet(ttm))
-                hist_.add_bonus(b, ttm, depth * depth);
+                hist_->add_bonus(b, ttm, depth * depth);
             return alpha;
         }
 
         avoid_null = tte.avoid_null;
     }
 
+    //WDL tables are exact right after a zeroing move
+    int max_score = VALUE_MATE;
+    if (tb_pieces_ && !b.half_moves() && !b.castling()
+            && popcnt(b.pieces()) <= tb_pieces_)
+    {
+        syzygy::ProbeState state;
+        const syzygy::WDLScore wdl = syzygy::probe_wdl(b, state);
+        if (state != syzygy::PROBE_FAIL) {
+            stats_.tb_hits++;
+            const int score = wdl < syzygy::WDL_BLESSED_LOSS ? -VALUE_TB_WIN + ply
+                : wdl > syzygy::WDL_CURSED_WIN ? VALUE_TB_WIN - ply
+                : 2 * wdl;
+            const Bound bound = wdl < syzygy::WDL_BLESSED_LOSS ? BOUND_ALPHA
+                : wdl > syzygy::WDL_CURSED_WIN ? BOUND_BETA
+                : BOUND_EXACT;
+
+            if (bound == BOUND_EXACT
+                    || (bound == BOUND_BETA ? score >= beta : score <= alpha))
+            {
+                tt_->store(TTEntry(b.key(), score, bound,
+                    std::min(MAX_DEPTH - 1, depth + 6), MOVE_NONE, ply, false));
+                if (bound == BOUND_EXACT)
+                    return score;
+                return bound == BOUND_BETA ? beta : alpha;
+            }
+
+            //in PV nodes keep searching, but within the known bound
+            if (pv && bound == BOUND_BETA)
+                alpha = std::max(alpha, score);
+            else if (pv)
+                max_score = score;
+        }
+    }
+
     int16_t eval = evaluate(b);
     bool improving = !b.checkers() && ply >= 2 
         && stack_.at(ply - 2).eval < eval;
 
-    if (depth >= 4 && !ttm)
+    if (features_.enabled(FEAT_IIR) && depth >= 4 && !ttm)
         --depth;
 
     if (pv || b.checkers())
         goto move_loop; //skip pruning
 
     //Reverse futility pruning
-    if (depth < 7 && eval - 175 * depth / (1 + improving) >= beta
+    if (features_.enabled(FEAT_RFP) && depth < 7 
+            && eval - 175 * depth / (1 + improving) >= beta
             && abs(beta) < MATE_BOUND)
+    {
+        STATS(instr_.rfp_cutoffs++);
         return eval;
+    }
 
     //Null move pruning
-    if (DO_NMP && depth >= 3
+    if (features_.enabled(FEAT_NMP) && depth >= 3
         && b.plies_from_null() && !avoid_null
         && b.has_nonpawns(b.side_to_move())
         && eval >= beta)
     {
         int R = 3 + depth / 6, n_depth = depth - R - 1;
-        size_t ndx = Tree::begin_node(MOVE_NULL, alpha, 
+        size_t ndx = tree_.begin_node(MOVE_NULL, alpha, 
                                       beta, n_depth, ply, NodeType::Null);
         stack_.push(b.key(), MOVE_NULL, eval);
+        STATS(instr_.nmp_tries++);
 
         int score = -search(b.do_null_move(), -beta, 
                 -beta + 1, n_depth);
 
         stack_.pop();
-        Tree::end_node(ndx, score);
+        tree_.end_node(ndx, score);
 
-        if (score >= beta)
+        if (score >= beta) {
+            STATS(instr_.nmp_cutoffs++);
             return beta;
+        }
 
         avoid_null = true;
     }
 
 move_loop:
+    const bool use_counters = features_.enabled(FEAT_COUNTERS);
+    const Move *killers = features_.enabled(FEAT_KILLERS) 
+        ? entry.killers : nullptr;
     Move opp_move = stack_.at(ply - 1).move,
          prev = MOVE_NONE, followup = MOVE_NONE,
-         counter = counters_[from_to(opp_move)];
+         counter = use_counters ? counters_[from_to(opp_move)] : MOVE_NONE;
     if (ply >= 2) {
         prev = stack_.at(ply - 2).move;
-        followup = followups_[from_to(prev)];
+        if (use_counters)
+            followup = followups_[from_to(prev)];
+    }
+
+    PieceToHistory *conts[2]{};
+    for (int i = 0; i < 2 && i < ply; ++i) {
+        const auto &prev_entry = stack_.at(ply - 1 - i);
+        if (prev_entry.moved != NO_PIECE)
+            conts[i] = &hist_->cont[prev_entry.moved][to_sq(prev_entry.move)];
     }
-    MovePicker mp(b, ttm, entry.killers, &hist_,
-            counter, followup);
+
+    MovePicker mp(b, ttm, killers, hist_.get(),
+            counter, followup, conts);
 
     Board bb{};
     auto search_move = [&](const Move m, int depth, const bool zw) {
-	    const size_t ndx = Tree::begin_node(m, alpha, beta, 
+	    const size_t ndx = tree_.begin_node(m, alpha, beta, 
 	                                        depth, ply);
 	    const int t_beta = zw ? -(alpha + 1) : -beta;
 	    const int score = -search(bb, t_beta, -alpha, depth);
-	    Tree::end_node(ndx, score);
+	    tree_.end_node(ndx, score);
         return score;
     };
 
     std::array<Move, 64> quiets{};
-    int num_quiets{};
+    std::array<Move, 32> captures{};
+    int num_quiets{}, num_captures{};
     int best_score = -VALUE_MATE, moves_tried = 0,
         old_alpha = alpha, score = 0;
     Move best_move = MOVE_NONE;
@@ -427,37 +649,46 @@ move_loop:
         bool is_quiet = b.is_quiet(m);
         int new_depth = depth - 1, r = 0;
         bool killer_or_counter = m == counter
-            || entry.killers[0] == m || entry.killers[1] == m;
+            || (killers && (killers[0] == m || killers[1] == m));
         bb = b.do_move(m);
 
         if (bb.checkers() && b.see_ge(m))
             new_depth++;
 
-        if (int lmp_threshold = (3 + 2 * depth * depth) / (2 - improving); !pv && !bb.checkers() && is_quiet
+        if (int lmp_threshold = (3 + 2 * depth * depth) / (2 - improving); 
+                features_.enabled(FEAT_LMP) && !pv && !bb.checkers() && is_quiet
                 && moves_tried > lmp_threshold) 
+        {
+            STATS(instr_.lmp_skips++);
             break;
+        }
 
-        if (depth > 2 && moves_tried > 1 && is_quiet) {
+        if (features_.enabled(FEAT_LMR) && depth > 2 
+                && moves_tried > 1 && is_quiet) 
+        {
             r = LMR[std::min(31, depth)][std::min(63, moves_tried)];
             if (!pv) ++r;
             if (!improving) ++r;
             if (killer_or_counter) r -= 2;
             if (bb.checkers()) --r;
 
-            r -= hist_.get_score(b, m) / 8192;
+            r -= hist_->get_score(b, m, conts) / 16384;
 
             r = std::clamp(r, 0, new_depth - 1);
             new_depth -= r;
         }
 
-        stack_.push(b.key(), m, eval);
+        stack_.push(b.key(), m, eval, b.piece_on(from_sq(m)));
 
         //Zero-window search
         if (!pv || moves_tried)
             score = search_move(m, new_depth, true);
 
+        STATS(instr_.lmr_searches += r > 0);
+
         //Re-search if reduced move beats alpha
         if (r && score > alpha) {
+            STATS(instr_.lmr_researches++);
             new_depth += r;
             score = search_move(m, new_depth, true);
         }
@@ -474,8 +705,12 @@ move_loop:
             best_move = m;
         }
 
-        if (b.is_quiet(m) && num_quiets < 64)
-            quiets[num_quiets++] = m;
+        if (b.is_quiet(m)) {
+            if (num_quiets < 64)
+                quiets[num_quiets++] = m;
+        } else if (num_captures < 32) {
+            captures[num_captures++] = m;
+        }
 
         if (score > alpha)
             alpha = score;
@@ -489,12 +724,17 @@ move_loop:
         return 0;
     }
 
+    alpha = std::min(alpha, max_score);
     if (alpha >= beta) {
         alpha = beta;
         stats_.fail_high++;
         stats_.fail_high_first += moves_tried == 1;
-        hist_.update(b, best_move, depth, 
-                quiets.data(), num_quiets);
+        STATS(instr_.add_cutoff(moves_tried - 1, 
+            stage_of(b, best_move, ttm, killers, counter, followup)));
+        hist_->update(b, best_move, depth, 
+                quiets.data(), num_quiets, conts);
+        hist_->update_captures(b, best_move, depth,
+                captures.data(), num_captures);
         if (b.is_quiet(best_move)) {
             if (entry.killers[0] != best_move) {
                 entry.killers[1] = entry.killers[0];
@@ -509,7 +749,7 @@ move_loop:
     }
 
     if (loop_.keep_going()) {
-        g_tt.store(TTEntry(b.key(), alpha, 
+        tt_->store(TTEntry(b.key(), alpha, 
             determine_bound(alpha, beta, old_alpha),
             depth, best_move, ply, avoid_null));
     }
@@ -545,21 +785,22 @@ int SearchWorker::quiescence(const Board &b,
             return beta;
     }
 
-    MovePicker mp(b);
+    MovePicker mp(b, hist_.get());
     Board bb{};
     constexpr bool only_tacticals = !with_evasions;
     int moves_tried = 0;
     for (Move m = mp.next<only_tacticals>(); m != MOVE_NONE; 
             m = mp.next<only_tacticals>(), ++moves_tried)
     {
-        if (!with_evasions && type_of(m) != PROMOTION
+        if (!with_evasions && features_.enabled(FEAT_DELTA) 
+                && type_of(m) != PROMOTION
                 && eval + cap_value(b, m) + 200 <= alpha) 
             continue;
 
-        const size_t ndx = Tree::begin_node(m, alpha, beta, 
+        const size_t ndx = tree_.begin_node(m, alpha, beta, 
                                             0, stack_.height());
         bb = b.do_move(m);
-        stack_.push(b.key(), m, eval);
+        stack_.push(b.key(), m, eval, b.piece_on(from_sq(m)));
 
         //filter out perpetual checks
         const bool gen_evasions = !with_evasions && bb.checkers();
@@ -567,7 +808,7 @@ int SearchWorker::quiescence(const Board &b,
 	                          : -quiescence<false>(bb, -beta, -alpha);
 
         stack_.pop();
-        Tree::end_node(ndx, score);
+        tree_.end_node(ndx, score);
 
         if (score > alpha)
             alpha = score;
@@ -5,8 +5,15 @@
 #include "../searchstack.hpp"
 #include "../board/board.hpp"
 #include "search_common.hpp"
+#include "search_stats.hpp"
 #include "routine.hpp"
 #include "../movepicker.hpp"
+#include "../tree.hpp"
+#include <functional>
+#include <memory>
+#include <vector>
+
+class TranspositionTable;
 
 struct RootMove {
     Move move;
@@ -18,7 +25,7 @@ class RootMovePicker {
 public:
     RootMovePicker() = default;
 
-    void reset(const Board &root);
+    void reset(const Board &root, const TranspositionTable &tt);
 
     [[nodiscard]] Move first() const;
     Move next();
@@ -26,6 +33,10 @@ public:
 
     [[nodiscard]] int num_moves() const;
 
+    //Keeps the moves that preserve the tablebase result, best DTZ first.
+    //st is the game history before root, score is the one of the first move
+    bool rank_by_dtz(const Board &root, Stack &st, int &score);
+
     void complete_iter();
 
 private:
@@ -33,6 +44,11 @@ private:
     int cur_{}, num_moves_{};
 };
 
+//pv holds pv_len moves
+using IterationCallback = std::function<void(const IterationStats &it,
+        const Move *pv, int pv_len)>;
+using DoneCallback = std::function<void(Move best)>;
+
 class SearchWorker {
 public:
     SearchWorker();
@@ -40,9 +56,28 @@ public:
     void go(const Board &root, const Stack &st,
             const SearchLimits &limits);
 
+    void new_game();
     void stop();
     void wait_for_completion();
 
+    //best move of the last search, also when it was silent
+    [[nodiscard]] Move best_move() const;
+
+    //Called on the search thread after every completed iteration and
+    //once at the end, also for silent searches. They must not call go().
+    //Stops a running search
+    void set_callbacks(IterationCallback on_iteration, DoneCallback on_done);
+
+    SearchFeatures &features();
+    //searches with `tt` instead of g_tt, set only while no search runs
+    void set_tt(TranspositionTable &tt);
+    [[nodiscard]] const std::vector<IterationStats> &iterations() const;
+    //nodes of the last iteration, recorded if the "trace" option is set
+    Tree &tree();
+#ifdef SEARCH_STATS
+    [[nodiscard]] const SearchCounters &counters() const;
+#endif
+
 private:
     void check_time();
     void iterative_deepening();
@@ -55,18 +90,33 @@ private:
     int quiescence(const Board &b, int alpha, int beta);
 
     bool is_draw() const;
+    //"go infinite" prints bestmove only after "stop"
+    void hold_until_stop() const;
 
     Board root_;
     Stack stack_;
+    TranspositionTable *tt_;
 
     RootMovePicker rmp_;
-    Histories hist_{};
+    std::unique_ptr<Histories> hist_;
     std::array<Move, 64 * 64> counters_{};
     std::array<Move, 64 * 64> followups_{};
 
     TimeMan man_{};
     SearchLimits limits_;
     SearchStats stats_;
+    SearchFeatures features_;
+    std::vector<IterationStats> iters_;
+    Tree tree_;
+    int tb_pieces_{}; //probe WDL tables with at most that many pieces
+    int tb_score_{};  //root score if the root is in the tablebases
+    Move tb_move_{};  //and its best DTZ move
+    Move best_{};
+    IterationCallback on_iteration_;
+    DoneCallback on_done_;
+#ifdef SEARCH_STATS
+    SearchCounters instr_;
+#endif
 
     Routine loop_;
 };
@@ -0,0 +1,152 @@
+#include "datagen.hpp"
+#include "core/searchworker.hpp"
+#include "movgen/generate.hpp"
+#include "board/packed.hpp"
+#include "game.hpp"
+#include "cli.hpp"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+/*
+ * FILE: datagen.cpp
+ * Positions in check, with a capture or promotion as the best move
+ * or with a mate score are not written: their static eval
+ * says little about the search score.
+ * */
+
+namespace {
+
+constexpr size_t FLUSH_ENTRIES = 4096;
+
+class Generator {
+public:
+    Generator(const std::string &path, const DatagenConfig &cfg)
+        : cfg_(cfg), ok_(out_.open(path)) {}
+
+    [[nodiscard]] bool ok() const { return ok_; }
+
+    void run(SearchWorker &worker, uint64_t seed);
+    void report(bool last);
+
+private:
+    void play_game(SearchWorker &worker, std::mt19937_64 &rng,
+            std::vector<PackedBoard> &samples);
+    void write(std::vector<PackedBoard> &entries);
+
+    PackedWriter out_;
+    std::mutex out_mtx_;
+    const DatagenConfig &cfg_;
+    const bool ok_;
+
+    std::atomic<int> next_game_{}, games_done_{};
+    TimePoint start_ = timer::now();
+};
+
+void Generator::play_game(SearchWorker &worker, std::mt19937_64 &rng,
+        std::vector<PackedBoard> &samples)
+{
+    Game game(Board::start_pos());
+    ExtMove moves[MAX_MOVES];
+
+    //a random opening, restarted if it runs into a finished game
+    while (game.ply() < cfg_.random_plies) {
+        const int n = static_cast<int>(generate<LEGAL>(game.board(), moves) - moves);
+        if (!n) {
+            game = Game(Board::start_pos());
+            continue;
+        }
+        game.play(moves[std::uniform_int_distribution<int>(0, n - 1)(rng)]);
+    }
+
+    worker.new_game();
+    std::vector<PackedBoard> entries;
+    while (!game.is_over()) {
+        Move m;
+        if (int score; game.search(worker, cfg_.limits, m, score)) {
+            if (game.adjudicate(score))
+                break;
+
+            const Board &b = game.board();
+            if (!b.checkers() && b.is_quiet(m) && abs(score) < MATE_BOUND)
+                entries.push_back(pack(b, score));
+        }
+        game.play(m);
+    }
+
+    const int result = game.result();
+    //result is from white's point of view until here
+    for (auto &e: entries) {
+        e.result = static_cast<int8_t>(e.stm == WHITE ? result : -result);
+        samples.push_back(e);
+    }
+}
+
+void Generator::write(std::vector<PackedBoard> &entries) {
+    std::lock_guard lock(out_mtx_);
+    out_.write(entries.data(), entries.size());
+    entries.clear();
+}
+
+void Generator::report(const bool last) {
+    const TimePoint elapsed = timer::now() - start_;
+    uint64_t positions;
+    {
+        std::lock_guard lock(out_mtx_);
+        positions = out_.count();
+    }
+    std::ostringstream ss;
+    if (last)
+        ss << "\nGames: " << games_done_
+           << "\nPositions: " << positions
+           << "\nTime (ms): " << elapsed
+           << "\nPositions/second: " << positions * 1000 / (elapsed + 1) << '\n';
+    else
+        ss << "info string datagen games " << games_done_
+           << " positions " << positions
+           << " pps " << positions * 1000 / (elapsed + 1) << '\n';
+    sync_cout() << ss.str();
+}
+
+void Generator::run(SearchWorker &worker, const uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<PackedBoard> samples;
+    while (next_game_.fetch_add(1) < cfg_.games) {
+        play_game(worker, rng, samples);
+        if (samples.size() >= FLUSH_ENTRIES)
+            write(samples);
+        if (const int done = ++games_done_; done % 100 == 0)
+            report(false);
+    }
+    write(samples);
+}
+
+} //namespace
+
+void datagen(const std::string &path, const DatagenConfig &cfg) {
+    Generator gen(path, cfg);
+    if (!gen.ok()) {
+        sync_cout() << "info string datagen: cannot open " << path << '\n';
+        return;
+    }
+
+    const int threads = std::max(cfg.threads, 1);
+    std::vector<std::unique_ptr<SearchWorker>> workers;
+    for (int i = 0; i < threads; ++i)
+        workers.push_back(std::make_unique<SearchWorker>());
+
+    const uint64_t seed = std::random_device{}();
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; ++i)
+        pool.emplace_back([&gen, &workers, seed, i] { gen.run(*workers[i], seed + i); });
+    gen.run(*workers[0], seed);
+    for (auto &t: pool)
+        t.join();
+
+    gen.report(true);
+}
@@ -0,0 +1,21 @@
+#ifndef DATAGEN_HPP
+#define DATAGEN_HPP
+
+#include <string>
+#include "core/search_common.hpp"
+
+struct DatagenConfig {
+    int games = 100;
+    int threads = 1;
+    int random_plies = 8; //uniformly random moves before the search plays
+    SearchLimits limits;
+};
+
+/*
+ * Self-play games on `threads` workers at fixed depth or node limits,
+ * appending the quiet positions with their search score and
+ * the game result to the file as PackedBoards.
+ * */
+void datagen(const std::string &path, const DatagenConfig &cfg);
+
+#endif
@@ -0,0 +1,121 @@
+#include "engine.hpp"
+#include "zobrist.hpp"
+#include "movgen/attack.hpp"
+#include "tt.hpp"
+#include "perft.hpp"
+#include "core/eval.hpp"
+#include "core/endgame.hpp"
+#include "primitives/utility.hpp"
+#include "nnue/nnue.h"
+#include <mutex>
+
+void Engine::init(const std::string &net) {
+    static std::once_flag once;
+    std::call_once(once, [&net]
+    {
+        init_zobrist();
+        init_attack_tables();
+        init_cuckoo();
+        init_ps_tables();
+        init_endgames();
+        init_reduction_tables();
+        g_tt.resize(128);
+        nnue_init(net.c_str());
+    });
+}
+
+Engine::Engine() {
+    init();
+    board_ = Board::start_pos();
+    st_.reset();
+}
+
+bool Engine::set_position(const std::string_view fen, const std::vector<std::string> &moves) {
+    Board b{};
+    if (!b.load_fen(fen))
+        return false;
+
+    const Board prev_board = board_;
+    const Stack prev_st = st_;
+    board_ = b;
+    st_.reset();
+    for (const auto &s: moves) {
+        if (!play(move_from_str(board_, s))) {
+            board_ = prev_board;
+            st_ = prev_st;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Engine::play(const Move m) {
+    if (m == MOVE_NONE || !board_.is_valid_move(m))
+        return false;
+    st_.push(board_.key(), m, 0, board_.piece_on(from_sq(m)));
+    st_.set_start(st_.height());
+    board_ = board_.do_move(m);
+    return true;
+}
+
+const Board &Engine::position() const {
+    return board_;
+}
+
+void Engine::new_game() {
+    worker_.new_game();
+}
+
+void Engine::set_hash(const size_t mbs) {
+    g_tt.resize(mbs);
+}
+
+SearchResult Engine::search(const SearchLimits &limits, const InfoCallback &on_info) {
+    SearchResult result;
+    search_async(limits, on_info, [&result](const SearchResult &r) { result = r; });
+    wait();
+    return result;
+}
+
+void Engine::search_async(SearchLimits limits, InfoCallback on_info,
+        ResultCallback on_done)
+{
+    worker_.set_callbacks(
+        [this, on_info = std::move(on_info)](const IterationStats &it,
+                const Move *pv, const int pv_len)
+        {
+            last_ = { it.depth, it.score, it.nodes, it.time,
+                std::vector<Move>(pv, pv + pv_len) };
+            if (on_info)
+                on_info(last_);
+        },
+        [this, on_done = std::move(on_done)](const Move best)
+        {
+            if (on_done)
+                on_done({ best, last_ });
+        });
+    //set_callbacks() waited for a running search, which writes last_
+    last_ = {};
+
+    limits.silent = true;
+    limits.start = timer::now();
+    if (!limits.time[WHITE] && !limits.time[BLACK] && !limits.move_time)
+        limits.infinite = true;
+    worker_.go(board_, st_, limits);
+}
+
+void Engine::stop() {
+    worker_.stop();
+}
+
+void Engine::wait() {
+    worker_.wait_for_completion();
+}
+
+int Engine::evaluate() const {
+    return ::evaluate(board_);
+}
+
+uint64_t Engine::perft(const int depth) const {
+    return ::perft(board_, depth);
+}
@@ -0,0 +1,71 @@
+#ifndef ENGINE_HPP
+#define ENGINE_HPP
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "board/board.hpp"
+#include "searchstack.hpp"
+#include "core/searchworker.hpp"
+
+struct SearchInfo {
+    int depth{};
+    int score{}; //side to move's view, mates are beyond MATE_BOUND
+    uint64_t nodes{};
+    TimePoint time{};
+    std::vector<Move> pv;
+};
+
+struct SearchResult {
+    Move best{};
+    SearchInfo info; //of the last completed iteration, empty if there was none
+};
+
+/*
+ * The engine without the UCI text layer, for embedding.
+ * Every Engine has its own position and search thread,
+ * the transposition table and the network are shared by the process.
+ * Limits work as for "go": without a time, move time or node limit
+ * the search only ends at max_depth or on stop().
+ * */
+class Engine {
+public:
+    using InfoCallback = std::function<void(const SearchInfo &)>;
+    using ResultCallback = std::function<void(const SearchResult &)>;
+
+    //Initialises the tables, the network and the TT on the first call,
+    //later calls do nothing. Engine() calls it with the default net
+    static void init(const std::string &net = "saturn.bin");
+
+    Engine();
+
+    //moves in UCI notation, the position is unchanged on failure
+    bool set_position(std::string_view fen, const std::vector<std::string> &moves = {});
+    bool play(Move m);
+    [[nodiscard]] const Board &position() const;
+
+    void new_game();
+    static void set_hash(size_t mbs);
+
+    //blocks until the search is done, on_info is called after every iteration
+    SearchResult search(const SearchLimits &limits, const InfoCallback &on_info = {});
+
+    //Returns at once, the callbacks run on the search thread
+    //and must not start another search
+    void search_async(SearchLimits limits, InfoCallback on_info,
+            ResultCallback on_done);
+    void stop();
+    void wait();
+
+    [[nodiscard]] int evaluate() const;
+    [[nodiscard]] uint64_t perft(int depth) const;
+
+private:
+    Board board_;
+    Stack st_;
+    SearchWorker worker_;
+    SearchInfo last_;
+};
+
+#endif
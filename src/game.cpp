@@ -0,0 +1,96 @@
+#include "game.hpp"
+#include "core/searchworker.hpp"
+#include "movgen/generate.hpp"
+#include <algorithm>
+
+namespace {
+
+constexpr int WIN_SCORE = 2000, WIN_PLIES = 4;
+constexpr int DRAW_SCORE = 10, DRAW_PLIES = 10, DRAW_MIN_PLY = 80;
+
+} //namespace
+
+Game::Game(const Board &start)
+    : board_(start) {}
+
+const Board &Game::board() const {
+    return board_;
+}
+
+int Game::ply() const {
+    return static_cast<int>(history_.size());
+}
+
+void Game::play(const Move m) {
+    history_.push_back({ board_.key(), m, board_.piece_on(from_sq(m)) });
+    board_ = board_.do_move(m);
+}
+
+//the positions since the last capture or pawn move, for repetitions
+void Game::fill_stack(Stack &st) const {
+    st.reset();
+    const size_t n = std::min(history_.size(), static_cast<size_t>(board_.half_moves()));
+    for (size_t i = history_.size() - n; i < history_.size(); ++i)
+        st.push(history_[i].key, history_[i].move, 0, history_[i].moved);
+    st.set_start(st.height());
+}
+
+bool Game::search(SearchWorker &worker, SearchLimits limits, Move &m, int &score) const {
+    Stack st;
+    fill_stack(st);
+    limits.silent = true;
+    limits.infinite = !limits.move_time;
+    limits.start = timer::now();
+    worker.go(board_, st, limits);
+    worker.wait_for_completion();
+
+    m = worker.best_move();
+    if (worker.iterations().empty())
+        return false;
+    score = worker.iterations().back().score;
+    return true;
+}
+
+bool Game::is_over() {
+    if (!has_legal_move(board_)) {
+        result_ = board_.checkers() ? (board_.side_to_move() == WHITE ? -1 : 1) : 0;
+        return true;
+    }
+
+    const size_t n = std::min(history_.size(), static_cast<size_t>(board_.half_moves()));
+    const bool repetition = std::any_of(history_.end() - static_cast<ptrdiff_t>(n), 
+        history_.end(), [this](const HistoryEntry &e) { return e.key == board_.key(); });
+    if (board_.half_moves() >= 100 || board_.is_material_draw()
+            || repetition || ply() >= MAX_GAME_PLIES) {
+        result_ = 0;
+        return true;
+    }
+    return false;
+}
+
+bool Game::adjudicate(const int score) {
+    //the searches of both sides in a row must agree, scores are from
+    //the side to move so a win seen by both flips sign every ply
+    const bool in_row = prev_ply_ == ply() - 1;
+    const bool agrees = in_row && (score > 0) != (prev_score_ > 0);
+    win_plies_ = abs(score) < WIN_SCORE ? 0
+        : win_plies_ && agrees ? win_plies_ + 1 : 1;
+    draw_plies_ = ply() >= DRAW_MIN_PLY && abs(score) <= DRAW_SCORE
+        ? (in_row ? draw_plies_ + 1 : 1) : 0;
+    prev_ply_ = ply();
+    prev_score_ = score;
+
+    if (win_plies_ >= WIN_PLIES) {
+        result_ = (board_.side_to_move() == WHITE) == (score > 0) ? 1 : -1;
+        return true;
+    }
+    if (draw_plies_ >= DRAW_PLIES) {
+        result_ = 0;
+        return true;
+    }
+    return false;
+}
+
+int Game::result() const {
+    return result_;
+}
@@ -0,0 +1,56 @@
+#ifndef GAME_HPP
+#define GAME_HPP
+
+#include <vector>
+#include "board/board.hpp"
+#include "core/search_common.hpp"
+
+class SearchWorker;
+class Stack;
+
+/*
+ * A game between searches, for datagen and match. It ends on mate,
+ * stalemate, insufficient material, the 50-move rule, the first
+ * repetition or MAX_GAME_PLIES, and it is adjudicated once the searches
+ * of both sides agree on a won or a dead drawn position for a few moves.
+ * */
+class Game {
+public:
+    static constexpr int MAX_GAME_PLIES = 400;
+
+    explicit Game(const Board &start);
+
+    [[nodiscard]] const Board &board() const;
+    [[nodiscard]] int ply() const;
+
+    void play(Move m);
+
+    //Searches the current position. Returns false if there was
+    //no iteration to take a score from (a single legal move)
+    bool search(SearchWorker &worker, SearchLimits limits, Move &m, int &score) const;
+
+    //true if the rules end the game here
+    bool is_over();
+    //score is the side to move's search score, true if it ends the game
+    bool adjudicate(int score);
+
+    //from white's point of view: 1, 0 or -1
+    [[nodiscard]] int result() const;
+
+private:
+    struct HistoryEntry {
+        uint64_t key;
+        Move move;
+        Piece moved;
+    };
+
+    void fill_stack(Stack &st) const;
+
+    Board board_;
+    std::vector<HistoryEntry> history_;
+    int win_plies_{}, draw_plies_{}, result_{};
+    //the last adjudicate() call
+    int prev_ply_ = -1, prev_score_{};
+};
+
+#endif
@@ -0,0 +1,259 @@
+#include "match.hpp"
+#include "core/searchworker.hpp"
+#include "movgen/generate.hpp"
+#include "game.hpp"
+#include "cli.hpp"
+#include "tt.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+/*
+ * FILE: match.cpp
+ * Results are counted per game pair (the same opening with colours
+ * reversed), which cancels most of the opening's bias: the five pair
+ * outcomes 0, 1/2, 1, 3/2 and 2 points for A form the pentanomial.
+ * Its mean and variance give the Elo error bars and the generalized
+ * SPRT log-likelihood ratio
+ *     LLR = N (s1 - s0) (2s - s0 - s1) / (2 var),
+ * where s0, s1 are the expected scores of elo0, elo1 and s, var the
+ * observed mean score and variance per pair. The test stops at
+ * log(beta / (1 - alpha)) and log((1 - beta) / alpha), alpha = beta = 0.05.
+ * */
+
+namespace {
+
+constexpr double ALPHA = 0.05, BETA = 0.05;
+constexpr int REPORT_PAIRS = 10;
+
+double expected_score(const double elo) {
+    return 1 / (1 + std::pow(10.0, -elo / 400));
+}
+
+double elo_of(const double score) {
+    return -400 * std::log10(1 / score - 1);
+}
+
+struct Stats {
+    int wins{}, draws{}, losses{};
+    int pairs[5]{};
+
+    [[nodiscard]] int games() const { return wins + draws + losses; }
+
+    //mean score and variance per pair, scaled to one game
+    void moments(double &mean, double &var) const {
+        const int n = pairs[0] + pairs[1] + pairs[2] + pairs[3] + pairs[4];
+        mean = var = 0;
+        if (!n)
+            return;
+        for (int i = 0; i < 5; ++i)
+            mean += i / 4.0 * pairs[i] / n;
+        for (int i = 0; i < 5; ++i)
+            var += (i / 4.0 - mean) * (i / 4.0 - mean) * pairs[i] / n;
+    }
+
+    [[nodiscard]] double llr(const double elo0, const double elo1) const {
+        double mean, var;
+        moments(mean, var);
+        if (var <= 0)
+            return 0;
+        const int n = pairs[0] + pairs[1] + pairs[2] + pairs[3] + pairs[4];
+        const double s0 = expected_score(elo0), s1 = expected_score(elo1);
+        return n * (s1 - s0) * (2 * mean - s0 - s1) / (2 * var);
+    }
+
+    [[nodiscard]] double los() const {
+        if (wins + losses == 0)
+            return 0.5;
+        return 0.5 * (1 + std::erf((wins - losses) / std::sqrt(2.0 * (wins + losses))));
+    }
+};
+
+class Match {
+public:
+    Match(std::vector<Board> openings, const MatchConfig &cfg)
+        : openings_(std::move(openings)), cfg_(cfg) {}
+
+    void run(SearchWorker &a, SearchWorker &b);
+    void report(bool last);
+
+private:
+    //returns A's points, 0, 1 or 2 (half points)
+    int play_game(SearchWorker *workers[2], const Board &opening, Color a_color);
+    void add_pair(const int points[2]);
+
+    std::vector<Board> openings_;
+    const MatchConfig &cfg_;
+
+    std::mutex stats_mtx_;
+    Stats stats_;
+    std::atomic<int> next_pair_{};
+    std::atomic<bool> done_{};
+    TimePoint start_ = timer::now();
+};
+
+int Match::play_game(SearchWorker *workers[2], const Board &opening, const Color a_color) {
+    Game game(opening);
+    workers[0]->new_game();
+    workers[1]->new_game();
+    while (!game.is_over()) {
+        const int side = game.board().side_to_move() == a_color ? 0 : 1;
+        Move m;
+        if (int score; game.search(*workers[side], cfg_.sides[side].limits, m, score)
+                && game.adjudicate(score))
+            break;
+        game.play(m);
+    }
+    const int result = a_color == WHITE ? game.result() : -game.result();
+    return result + 1;
+}
+
+void Match::add_pair(const int points[2]) {
+    std::lock_guard lock(stats_mtx_);
+    for (int i = 0; i < 2; ++i) {
+        stats_.wins += points[i] == 2;
+        stats_.draws += points[i] == 1;
+        stats_.losses += points[i] == 0;
+    }
+    ++stats_.pairs[points[0] + points[1]];
+
+    const double llr = stats_.llr(cfg_.elo0, cfg_.elo1);
+    if (llr <= std::log(BETA / (1 - ALPHA)) || llr >= std::log((1 - BETA) / ALPHA))
+        done_ = true;
+}
+
+void Match::report(const bool last) {
+    Stats s;
+    {
+        std::lock_guard lock(stats_mtx_);
+        s = stats_;
+    }
+    double mean, var;
+    s.moments(mean, var);
+    const int n = s.pairs[0] + s.pairs[1] + s.pairs[2] + s.pairs[3] + s.pairs[4];
+    const double margin = n ? 1.96 * std::sqrt(var / n) : 0;
+
+    //a score of 0 or 1 has no finite Elo
+    auto elo = [](const double score) {
+        return elo_of(std::clamp(score, 0.001, 0.999));
+    };
+    const double llr = s.llr(cfg_.elo0, cfg_.elo1);
+    const double lower = std::log(BETA / (1 - ALPHA)), upper = std::log((1 - BETA) / ALPHA);
+
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(2);
+    if (last) {
+        ss << "\nGames: " << s.games()
+           << "\nScore (A): " << s.wins << " - " << s.draws << " - " << s.losses
+           << "\nPairs (0-2 points): " << s.pairs[0] << ' ' << s.pairs[1] << ' '
+           << s.pairs[2] << ' ' << s.pairs[3] << ' ' << s.pairs[4]
+           << "\nElo: " << elo(mean) << " [" << elo(mean - margin)
+           << ", " << elo(mean + margin) << ']'
+           << "\nLOS: " << s.los() * 100 << '%'
+           << "\nLLR: " << llr << " [" << lower << ", " << upper << "] elo0 "
+           << cfg_.elo0 << " elo1 " << cfg_.elo1
+           << "\nSPRT: " << (llr >= upper ? "H1 accepted" : llr <= lower
+                ? "H0 accepted" : "inconclusive")
+           << "\nTime (ms): " << timer::now() - start_ << '\n';
+    } else {
+        ss << "info string match games " << s.games()
+           << " wdl " << s.wins << ' ' << s.draws << ' ' << s.losses
+           << " elo " << elo(mean) << " llr " << llr << '\n';
+    }
+    sync_cout() << ss.str();
+}
+
+void Match::run(SearchWorker &a, SearchWorker &b) {
+    a.features() = cfg_.sides[0].features;
+    b.features() = cfg_.sides[1].features;
+    SearchWorker *workers[2] = { &a, &b };
+
+    const int pairs = (cfg_.games + 1) / 2;
+    for (int i; !done_ && (i = next_pair_.fetch_add(1)) < pairs; ) {
+        const Board &opening = openings_[i % openings_.size()];
+        const int points[2] = {
+            play_game(workers, opening, WHITE),
+            play_game(workers, opening, BLACK),
+        };
+        add_pair(points);
+        if ((i + 1) % REPORT_PAIRS == 0)
+            report(false);
+    }
+}
+
+} //namespace
+
+bool MatchSide::set(const std::string &key, const std::string &value) {
+    std::istringstream is(value);
+    if (key == "depth") {
+        if (!(is >> limits.max_depth))
+            return false;
+        limits.max_depth = std::clamp(limits.max_depth, 1, MAX_DEPTH - 1);
+        return true;
+    }
+    if (key == "nodes") {
+        limits.max_depth = MAX_DEPTH - 1;
+        return static_cast<bool>(is >> limits.nodes);
+    }
+    if (key == "movetime") {
+        limits.max_depth = MAX_DEPTH - 1;
+        return static_cast<bool>(is >> limits.move_time);
+    }
+#ifdef RUNTIME_FEATURES
+    for (int i = 0; i < FEATURE_NB; ++i) {
+        if (key == FEATURE_NAMES[i] && (value == "true" || value == "false")) {
+            features.set(static_cast<SearchFeature>(i), value == "true");
+            return true;
+        }
+    }
+#endif
+    return false;
+}
+
+void match(const std::string &path, const MatchConfig &cfg) {
+    std::ifstream f(path);
+    if (!f) {
+        sync_cout() << "info string match: cannot open " << path << '\n';
+        return;
+    }
+
+    //finished positions are no openings
+    std::vector<Board> openings;
+    for (std::string line; std::getline(f, line); ) {
+        Board b;
+        if (b.load_fen(line) && has_legal_move(b))
+            openings.push_back(b);
+    }
+    if (openings.empty()) {
+        sync_cout() << "info string match: no openings in " << path << '\n';
+        return;
+    }
+
+    Match m(std::move(openings), cfg);
+
+    const int threads = std::max(cfg.threads, 1);
+    std::vector<std::unique_ptr<SearchWorker>> workers;
+    std::vector<std::unique_ptr<TranspositionTable>> tables;
+    for (int i = 0; i < 2 * threads; ++i) {
+        workers.push_back(std::make_unique<SearchWorker>());
+        tables.push_back(std::make_unique<TranspositionTable>());
+        tables.back()->resize(std::max(cfg.hash, 1));
+        workers.back()->set_tt(*tables.back());
+    }
+
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; ++i)
+        pool.emplace_back([&m, &workers, i] { m.run(*workers[2 * i], *workers[2 * i + 1]); });
+    m.run(*workers[0], *workers[1]);
+    for (auto &t: pool)
+        t.join();
+
+    m.report(true);
+}
@@ -0,0 +1,37 @@
+#ifndef MATCH_HPP
+#define MATCH_HPP
+
+#include <string>
+#include "core/search_common.hpp"
+
+//One engine configuration: its per-move limits and search features
+struct MatchSide {
+    SearchLimits limits;
+    SearchFeatures features;
+
+    //"depth", "nodes", "movetime" or a feature name ("true"/"false",
+    //debug and ABLATION builds only), false if it cannot be set
+    bool set(const std::string &key, const std::string &value);
+};
+
+struct MatchConfig {
+    MatchSide sides[2];
+    int games = 1000;
+    int threads = 1;
+    //MB, every side of every thread has its own table
+    int hash = 16;
+    //SPRT hypotheses, in logistic Elo
+    double elo0 = 0, elo1 = 5;
+};
+
+/*
+ * Plays configuration A against B in game pairs from the openings in
+ * `path` (FEN or EPD lines), each opening once with either colour,
+ * on `threads` pairs of independent workers. Each worker has its own
+ * TT, so neither side probes entries the other one stored.
+ * Reports the score, Elo, LOS and an SPRT verdict, and stops
+ * early once the SPRT accepts either hypothesis.
+ * */
+void match(const std::string &path, const MatchConfig &cfg);
+
+#endif
@@ -3,6 +3,10 @@
 #include <algorithm>
 #include <cstring>
 
+#if defined(USE_AVX2)
+#include <immintrin.h>
+#endif
+
 namespace {
 
 void insertion_sort(ExtMove *begin, const ExtMove *end) {
@@ -26,9 +30,10 @@ constexpr int16_t MVV_LVA[PIECE_TYPE_NB][PIECE_TYPE_NB] = {
 
 //http://www.talkchess.com/forum3/viewtopic.php?t=66312
 //This one is huuge
-constexpr int16_t SortingTypes[PIECE_TYPE_NB] = {0, 10, 8, 8, 4, 3, 1};
+//int32_t to be gathered by score_quiets_avx2
+constexpr int32_t SortingTypes[PIECE_TYPE_NB] = {0, 10, 8, 8, 4, 3, 1};
 
-constexpr int16_t SortingTable[SQUARE_NB] = {
+constexpr int32_t SortingTable[SQUARE_NB] = {
     0, 0, 0, 0, 0, 0, 0, 0,
     1, 2, 2, 2, 2, 2, 2, 1,
     1, 2, 4, 4, 4, 4, 2, 1,
@@ -39,41 +44,170 @@ constexpr int16_t SortingTable[SQUARE_NB] = {
     0, 0, 0, 0, 0, 0, 0, 0,
 };
 
+template<typename T>
+void halve(T &table) {
+    int16_t *entry = reinterpret_cast<int16_t*>(table.data());
+    for (size_t i = 0; i < sizeof(table) / sizeof(int16_t); ++i)
+        entry[i] /= 2;
+}
+
+void gravity(int16_t &entry, const int bonus) {
+    entry += 32 * bonus - entry * abs(bonus) / 512;
+}
+
+PieceType captured_type(const Board &b, const Move m) {
+    if (type_of(m) == EN_PASSANT)
+        return PAWN;
+    return type_of(b.piece_on(to_sq(m)));
+}
+
+#if defined(USE_AVX2)
+//gathers 8 int16_t table entries, the 2 bytes read past
+//an entry always belong to the same Histories object
+__m256i gather_i16(const int16_t *table, const __m256i idx) {
+    const __m256i v = _mm256_i32gather_epi32(
+        reinterpret_cast<const int*>(table), idx, 2);
+    return _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
 }
 
+/*
+ * Same terms as the scalar loop in score_nontactical, 8 moves at a time.
+ * Returns the number of moves scored, the rest is left for the caller.
+ * */
+int score_quiets_avx2(const Board &b, ExtMove *moves, const int n,
+        const Histories *hist, const PieceToHistory *const *conts)
+{
+    static_assert(sizeof(ExtMove) == 8);
+    //ExtMove::move is the low half of every other int32
+    const __m256i move_idx = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+    const __m256i sq_mask = _mm256_set1_epi32(63);
+    const auto *mailbox = reinterpret_cast<const int*>(b.mailbox());
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256i m = _mm256_and_si256(_mm256_set1_epi32(0xFFFF),
+            _mm256_i32gather_epi32(reinterpret_cast<const int*>(moves + i), 
+                move_idx, 4));
+        const __m256i to = _mm256_and_si256(m, sq_mask);
+        const __m256i from = _mm256_and_si256(_mm256_srli_epi32(m, 6), sq_mask);
+        //a Board has plenty of members after its mailbox
+        const __m256i pc = _mm256_and_si256(_mm256_set1_epi32(0xFF),
+            _mm256_i32gather_epi32(mailbox, from, 1));
+        const __m256i pt = _mm256_and_si256(pc, _mm256_set1_epi32(7));
+
+        __m256i v = _mm256_mullo_epi32(
+            _mm256_i32gather_epi32(SortingTypes, pt, 4),
+            _mm256_sub_epi32(_mm256_i32gather_epi32(SortingTable, to, 4),
+                             _mm256_i32gather_epi32(SortingTable, from, 4)));
+
+        if (hist) {
+            //[color][from][to]
+            const __m256i main_idx = _mm256_or_si256(
+                _mm256_slli_epi32(_mm256_srli_epi32(pc, 3), 12),
+                _mm256_or_si256(_mm256_slli_epi32(from, 6), to));
+            v = _mm256_add_epi32(v, gather_i16(&hist->main[0][0][0], main_idx));
+
+            //[piece][to]
+            const __m256i cont_idx = _mm256_or_si256(
+                _mm256_slli_epi32(pc, 6), to);
+            for (int c = 0; c < 2; ++c)
+                if (conts && conts[c])
+                    v = _mm256_add_epi32(v, gather_i16(&(*conts[c])[0][0], cont_idx));
+        }
+
+        alignas(32) int32_t values[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(values), v);
+        for (int k = 0; k < 8; ++k)
+            moves[i + k].value = values[k];
+    }
+
+    return i;
+}
+#endif
+
+} //namespace
+
 void Histories::reset() {
     memset(main.data(), 0, sizeof(main));
+    memset(cont.data(), 0, sizeof(cont));
+    memset(capture.data(), 0, sizeof(capture));
+}
+
+//Keep the ordering knowledge from the previous move,
+//but let the fresh search outweigh it quickly
+void Histories::age() {
+    halve(main);
+    halve(cont);
+    halve(capture);
 }
 
 void Histories::add_bonus(const Board &b, const Move m, const int16_t bonus) {
 	const Square from = from_sq(m), to = to_sq(m);
     const Piece p = b.piece_on(from);
 
-    int16_t &entry = main[color_of(p)][from][to];
-    entry += 32 * bonus - entry * abs(bonus) / 512;
+    gravity(main[color_of(p)][from][to], bonus);
 }
 
 void Histories::update(const Board &b, const Move bm,
-                       const int depth, const Move *quiets, const int nq)
+                       const int depth, const Move *quiets, const int nq,
+                       PieceToHistory *const *conts)
 {
 	const int inc = std::min(depth * depth, 576);
-	if (const bool quiet = b.is_quiet(bm)) {
-        add_bonus(b, bm, inc);
+    if (!b.is_quiet(bm))
+        return;
+
+    auto update_one = [&](const Move m, const int bonus) {
+        const Piece p = b.piece_on(from_sq(m));
+        add_bonus(b, m, static_cast<int16_t>(bonus));
+        for (int i = 0; i < 2; ++i)
+            if (conts[i])
+                gravity((*conts[i])[p][to_sq(m)], bonus);
+    };
+
+    update_one(bm, inc);
+    for (int i = 0; i < nq - 1; ++i)
+        update_one(quiets[i], -inc);
+}
 
-        for (int i = 0; i < nq - 1; ++i)
-            add_bonus(b, quiets[i], -inc);
-    }
+void Histories::update_captures(const Board &b, const Move bm,
+                                const int depth, const Move *captures, const int nc)
+{
+	const int inc = std::min(depth * depth, 576);
+
+    auto update_one = [&](const Move m, const int bonus) {
+        const Piece p = b.piece_on(from_sq(m));
+        gravity(capture[p][to_sq(m)][captured_type(b, m)], bonus);
+    };
+
+    if (!b.is_quiet(bm))
+        update_one(bm, inc);
+    for (int i = 0; i < nc; ++i)
+        if (captures[i] != bm)
+            update_one(captures[i], -inc);
 }
 
-int16_t Histories::get_score(const Board &b, const Move m) const {
+int Histories::get_score(const Board &b, const Move m,
+                         const PieceToHistory *const *conts) const 
+{
 	const Square from = from_sq(m), to = to_sq(m);
     const Piece p = b.piece_on(from);
-    return main[color_of(p)][from][to];
+
+    int score = main[color_of(p)][from][to];
+    for (int i = 0; i < 2; ++i)
+        if (conts && conts[i])
+            score += (*conts[i])[p][to];
+    return score;
+}
+
+int16_t Histories::get_capture_score(const Board &b, const Move m) const {
+    const Piece p = b.piece_on(from_sq(m));
+    return capture[p][to_sq(m)][captured_type(b, m)];
 }
 
 MovePicker::MovePicker(const Board &board, const Move ttm,
         const Move *killers, const Histories *histories,
-        const Move counter, const Move followup)
+        const Move counter, const Move followup,
+        const PieceToHistory *const *conts)
     : board_(board), ttm_(ttm), counter_(counter), 
       followup_(followup), hist_(histories),
       stage_(ttm ? Stage::TT_MOVE : Stage::INIT_TACTICAL)
@@ -82,10 +216,14 @@ MovePicker::MovePicker(const Board &board, const Move ttm,
         killers_[0] = killers[0];
         killers_[1] = killers[1];
     }
+    if (conts) {
+        conts_[0] = conts[0];
+        conts_[1] = conts[1];
+    }
 }
 
-MovePicker::MovePicker(const Board &board)
-    : board_(board), stage_(Stage::INIT_TACTICAL)
+MovePicker::MovePicker(const Board &board, const Histories *histories)
+    : board_(board), hist_(histories), stage_(Stage::INIT_TACTICAL)
 {}
 
 template Move MovePicker::next<true>();
@@ -103,13 +241,13 @@ Move MovePicker::next() {
         end_bad_caps_ = cur_ = moves_;
         end_ = generate<TACTICAL>(board_, cur_);
         score_tactical();
-        insertion_sort(cur_, end_);
+        lazy_picks_ = LAZY_PICKS;
 
         [[fallthrough]];
     case Stage::GOOD_TACTICAL:
-        m = select([this]
+        m = select<true>([this]
         {
-            if (board_.see_ge(*cur_)) return true;
+            if (cur_->value >= 0) return true;
             *end_bad_caps_++ = *cur_;
             return false;
         });
@@ -156,7 +294,7 @@ Move MovePicker::next() {
         [[fallthrough]];
 
     case Stage::BAD_TACTICAL:
-        if ((m = select()) != MOVE_NONE)
+        if ((m = select<false>()) != MOVE_NONE)
             return m;
 
         stage_ = Stage::INIT_NONTACTICAL;
@@ -166,11 +304,11 @@ Move MovePicker::next() {
         cur_ = moves_;
         end_ = generate<NON_TACTICAL>(board_, cur_);
         score_nontactical();
-        insertion_sort(cur_, end_);
+        lazy_picks_ = LAZY_PICKS;
 
         [[fallthrough]];
     case Stage::NON_TACTICAL:
-        return select([this]
+        return select<true>([this]
         {
             return *cur_ != killers_[0]
                 && *cur_ != killers_[1]
@@ -185,33 +323,63 @@ Move MovePicker::next() {
 
 Stage MovePicker::stage() const { return stage_; }
 
+/*
+ * Good captures (SEE >= 0) come first, value >= 0 tells them apart.
+ * Within each group: MVV/LVA, then capture history.
+ * */
 void MovePicker::score_tactical() const
 {
+    board_.see_all(cur_, end_);
     for (auto it = cur_; it != end_; ++it) {
         PieceType victim = type_of(board_.piece_on(to_sq(*it)));
         const PieceType attacker = type_of(board_.piece_on(from_sq(*it)));
         if (victim == NO_PIECE_TYPE)
             victim = prom_type(*it);
 
-        it->value = MVV_LVA[victim][attacker];
+        //as with see_ge, promotions and en passant always count as good
+        const bool bad = type_of(*it) == NORMAL && it->value < 0;
+
+        //capture history can only reorder captures of similar MVV/LVA class
+        it->value = MVV_LVA[victim][attacker] * 1024 + 1024;
+        if (hist_)
+            it->value += hist_->get_capture_score(board_, *it) / 16;
+        if (bad)
+            it->value -= 65536;
     }
 }
 
 void MovePicker::score_nontactical() const
 {
-    for (auto it = cur_; it != end_; ++it) {
+    auto it = cur_;
+#if defined(USE_AVX2)
+    it += score_quiets_avx2(board_, cur_, static_cast<int>(end_ - cur_),
+            hist_, conts_.data());
+#endif
+    for (; it != end_; ++it) {
 	    const Square from = from_sq(*it), to = to_sq(*it);
         const Piece p = board_.piece_on(from);
-        const int16_t k = SortingTypes[type_of(p)];
+        const int32_t k = SortingTypes[type_of(p)];
         it->value = k * (SortingTable[to] - SortingTable[from]);
         if (hist_)
-            it->value += hist_->main[color_of(p)][from][to];
+            it->value += hist_->get_score(board_, *it, conts_.data());
     }
 }
 
-template<typename F>
+/*
+ * Most nodes cut off after a few moves, so the first LAZY_PICKS moves
+ * of a stage are picked as the best remaining one, and only a node that
+ * gets past them pays for sorting the rest (lazy_picks_ is -1 after).
+ * */
+template<bool pick_best, typename F>
 Move MovePicker::select(F &&filter) {
     for (; cur_ != end_; ++cur_) {
+        if (pick_best && lazy_picks_ > 0) {
+            std::iter_swap(cur_, std::max_element(cur_, end_));
+            --lazy_picks_;
+        } else if (pick_best && !lazy_picks_) {
+            insertion_sort(cur_, end_);
+            lazy_picks_ = -1;
+        }
         if (*cur_ != ttm_ && filter())
             return *cur_++;
     }
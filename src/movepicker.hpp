@@ -25,6 +25,11 @@ enum class Stage {
 
 class Board;
 
+//[piece][to] of the move being scored
+using PieceToHistory = std::array<
+    std::array<int16_t, SQUARE_NB>, 
+    PIECE_NB>;
+
 struct Histories {
     std::array<
         std::array<
@@ -32,12 +37,29 @@ struct Histories {
             SQUARE_NB>,
         COLOR_NB> main;
 
+    //[piece][to] of the move 1 or 2 plies back
+    std::array<
+        std::array<PieceToHistory, SQUARE_NB>,
+        PIECE_NB> cont;
+
+    //[piece][to][captured]
+    std::array<
+        std::array<
+            std::array<int16_t, PIECE_TYPE_NB>, 
+            SQUARE_NB>,
+        PIECE_NB> capture;
+
     void reset();
+    void age();
     void add_bonus(const Board &b, Move m, int16_t bonus);
     void update(const Board &b, Move bm, int depth,
-            const Move *quiets, int nq);
+            const Move *quiets, int nq, PieceToHistory *const *conts);
+    void update_captures(const Board &b, Move bm, int depth,
+            const Move *captures, int nc);
 
-    [[nodiscard]] int16_t get_score(const Board &b, Move m) const;
+    [[nodiscard]] int get_score(const Board &b, Move m,
+            const PieceToHistory *const *conts) const;
+    [[nodiscard]] int16_t get_capture_score(const Board &b, Move m) const;
 };
 
 class MovePicker {
@@ -46,9 +68,11 @@ public:
         const Move *killers = nullptr,
         const Histories *histories = nullptr,
         Move counter = MOVE_NONE,
-        Move followup = MOVE_NONE);
+        Move followup = MOVE_NONE,
+        const PieceToHistory *const *conts = nullptr);
     //for quiescence
-    MovePicker(const Board &board);
+    MovePicker(const Board &board, 
+        const Histories *histories = nullptr);
 
     template<bool qmoves>
     Move next();
@@ -63,7 +87,7 @@ private:
         bool operator()() const { return true; }
     };
 
-    template<typename F = AnyMove>
+    template<bool pick_best, typename F = AnyMove>
     Move select(F &&filter = AnyMove());
 
     const Board &board_;
@@ -73,7 +97,11 @@ private:
     Move ttm_{}, counter_{}, followup_{};
     std::array<Move, 2> killers_{};
     const Histories *hist_{};
+    std::array<const PieceToHistory*, 2> conts_{};
     Stage stage_;
+
+    static constexpr int LAZY_PICKS = 3;
+    int lazy_picks_{};
 };
 
 #endif
@@ -6,16 +6,68 @@
 
 namespace {
 
+/*
+ * The generators write into a sink: either a move list or
+ * a counter, which popcounts destinations instead.
+ * */
+struct MoveCount {
+    int n;
+};
+
+ExtMove* add(ExtMove *moves, const Move m) {
+    *moves++ = m;
+    return moves;
+}
+
+MoveCount add(MoveCount c, Move) {
+    ++c.n;
+    return c;
+}
+
+ExtMove* add_all(ExtMove *moves, const Square from, Bitboard dsts) {
+    while (dsts)
+        *moves++ = make_move(from, pop_lsb(dsts));
+    return moves;
+}
+
+MoveCount add_all(MoveCount c, Square, const Bitboard dsts) {
+    c.n += popcnt(dsts);
+    return c;
+}
+
 /*---------------------Pawn moves--------------------*/
 
-ExtMove* make_proms(const Square from, const Square to, ExtMove *moves) {
-    *moves++ = make<PROMOTION>(from, to, KNIGHT);
-    *moves++ = make<PROMOTION>(from, to, BISHOP);
-    *moves++ = make<PROMOTION>(from, to, ROOK);
-    *moves++ = make<PROMOTION>(from, to, QUEEN);
+//dsts are the target squares, each reached from to - delta
+ExtMove* add_shifted(ExtMove *moves, Bitboard dsts, const int delta) {
+    while (dsts) {
+        const Square to = pop_lsb(dsts);
+        *moves++ = make_move(static_cast<Square>(to - delta), to);
+    }
+    return moves;
+}
+
+MoveCount add_shifted(MoveCount c, const Bitboard dsts, int) {
+    c.n += popcnt(dsts);
+    return c;
+}
+
+ExtMove* add_proms(ExtMove *moves, Bitboard dsts, const int delta) {
+    while (dsts) {
+        const Square to = pop_lsb(dsts);
+        const auto from = static_cast<Square>(to - delta);
+        *moves++ = make<PROMOTION>(from, to, KNIGHT);
+        *moves++ = make<PROMOTION>(from, to, BISHOP);
+        *moves++ = make<PROMOTION>(from, to, ROOK);
+        *moves++ = make<PROMOTION>(from, to, QUEEN);
+    }
     return moves;
 }
 
+MoveCount add_proms(MoveCount c, const Bitboard dsts, int) {
+    c.n += 4 * popcnt(dsts);
+    return c;
+}
+
 bool legal_ep_move(const Board &b, const Square from, const Square to) {
 	const Square cap_sq = make_square(file_of(to), rank_of(from));
 	const Bitboard combined = b.pieces()
@@ -35,16 +87,28 @@ bool legal_ep_move(const Board &b, const Square from, const Square to) {
     return !bb;
 }
 
-template<GenType T, bool IN_CHECK>
-ExtMove* pawn_legals(const Board &b, ExtMove *moves) {
-	const Color us = b.side_to_move(), them = ~us;
-    const Square ksq = b.king_square(us);
-    Bitboard our_pawns = b.pieces(us, PAWN);
-    if (!(T & TACTICAL))
-        our_pawns &= ~relative_rank_bb(us, RANK_7);
-
-	const Bitboard my_r3 = relative_rank_bb(us, RANK_3),
-	               my_r8 = relative_rank_bb(us, RANK_8);
+/*
+ * Unpinned pawns are moved all at once by shifting the whole set,
+ * pinned ones (never movable in check) one by one along the pin.
+ * */
+template<Color Us, GenType T, bool IN_CHECK, typename Out>
+Out pawn_legals(const Board &b, Out moves) {
+    constexpr Color them = ~Us;
+    constexpr Direction up = Us == WHITE ? NORTH : SOUTH,
+              up_west = Us == WHITE ? NORTH_WEST : SOUTH_WEST,
+              up_east = Us == WHITE ? NORTH_EAST : SOUTH_EAST;
+    constexpr int d_up = Us == WHITE ? 8 : -8,
+              d_west = Us == WHITE ? 7 : -9,
+              d_east = Us == WHITE ? 9 : -7;
+
+    const Square ksq = b.king_square(Us);
+    const Bitboard our_pawns = b.pieces(Us, PAWN),
+                   pinned = b.blockers_for_king(Us),
+                   empty = ~b.pieces(),
+                   enemies = b.pieces(them);
+	const Bitboard my_r3 = relative_rank_bb(Us, RANK_3),
+	               my_r7 = relative_rank_bb(Us, RANK_7),
+	               my_r8 = relative_rank_bb(Us, RANK_8);
 
     Bitboard check_mask = ~static_cast<Bitboard>(0);
     if (IN_CHECK) {
@@ -52,86 +116,83 @@ ExtMove* pawn_legals(const Board &b, ExtMove *moves) {
             | b.checkers();
     }
 
-    const Bitboard pinned = b.blockers_for_king(us);
-    Bitboard pawns = our_pawns & ~pinned;
-
-    //May be 2 loops: first for < 7th rank, second for 7th rank?
-    while (pawns) {
-	    const Square from = pop_lsb(pawns);
-
-        Bitboard dsts = pawn_pushes_bb(us, from) & ~b.pieces();
-        if (!(T & NON_TACTICAL))
-            dsts &= my_r8;
-        if (T & NON_TACTICAL) {
-            Bitboard bb = (my_r3 & b.pieces()) & ~square_bb(from);
-            bb = (bb << 8) | (bb >> 8);
-            dsts &= ~bb;
-        }
-
-        if (T & TACTICAL)
-            dsts |= pawn_attacks_bb(us, from) & b.pieces(them);
+    const Bitboard pawns = our_pawns & ~pinned,
+                   low = pawns & ~my_r7,
+                   high = pawns & my_r7;
 
-        if (IN_CHECK)
-            dsts &= check_mask;
+    if (T & NON_TACTICAL) {
+        const Bitboard single = shift<up>(low) & empty;
+        const Bitboard dbl = shift<up>(single & my_r3) & empty;
+        moves = add_shifted(moves, single & check_mask, d_up);
+        moves = add_shifted(moves, dbl & check_mask, 2 * d_up);
+    }
 
-        Bitboard bb = dsts & my_r8;
-        while ((T & TACTICAL) && bb)
-            moves = make_proms(from, pop_lsb(bb), moves);
+    if (T & TACTICAL) {
+        const Bitboard targets = enemies & check_mask;
+        moves = add_shifted(moves, shift<up_west>(low) & targets, d_west);
+        moves = add_shifted(moves, shift<up_east>(low) & targets, d_east);
 
-        bb = dsts & ~my_r8;
-        while (bb)
-            *moves++ = make_move(from, pop_lsb(bb));
+        moves = add_proms(moves, shift<up>(high) & empty & check_mask, d_up);
+        moves = add_proms(moves, shift<up_west>(high) & targets, d_west);
+        moves = add_proms(moves, shift<up_east>(high) & targets, d_east);
     }
 
     if (!IN_CHECK) {
-        pawns = our_pawns & pinned;
-        while (pawns) {
-	        const Square from = pop_lsb(pawns);
+        Bitboard bb = our_pawns & pinned;
+        while (bb) {
+	        const Square from = pop_lsb(bb);
+            const Bitboard from_bb = square_bb(from), 
+                           pin = line_bb(ksq, from);
 
             Bitboard dsts = 0;
             if (T & NON_TACTICAL) {
-                dsts |= pawn_pushes_bb(us, from) & ~b.pieces();
-                Bitboard bb = (my_r3 & b.pieces()) & ~square_bb(from);
-                bb = (bb << 8) | (bb >> 8);
-                dsts &= ~bb;
+                const Bitboard single = shift<up>(from_bb) & empty;
+                dsts |= single | (shift<up>(single & my_r3) & empty);
             }
-
             if (T & TACTICAL)
-                dsts |= pawn_attacks_bb(us, from) & b.pieces(them);
+                dsts |= pawn_attacks_bb(Us, from) & enemies;
+            dsts &= pin;
 
-            dsts &= line_bb(ksq, from);
-            
-            Bitboard bb = dsts & my_r8;
-            while ((T & TACTICAL) && bb)
-                moves = make_proms(from, pop_lsb(bb), moves);
-
-            bb = dsts & ~my_r8;
-            while (bb)
-                *moves++ = make_move(from, pop_lsb(bb));
+            //a pinned pawn can only promote by capturing the pinner
+            if (const Bitboard proms = dsts & my_r8; (T & TACTICAL) && proms)
+                moves = add_proms(moves, proms, lsb(proms) - from);
+            moves = add_all(moves, from, dsts & ~my_r8);
         }
     }
 
     //branchy boiii
 	if (const Square ep = b.en_passant(); (T & TACTICAL) && ep != SQ_NONE) {
 	    const Square to = ep;
-	    const Bitboard rbb = relative_rank_bb(us, RANK_5),
+        const auto cap_sq = static_cast<Square>(to - d_up);
+        //in check, the pawn must be the checker or block a check
+        if (IN_CHECK && !(check_mask & (square_bb(to) | square_bb(cap_sq))))
+            return moves;
+
+	    const Bitboard rbb = relative_rank_bb(Us, RANK_5),
 	                   fbb = adjacent_files_bb(file_of(to));
         Bitboard bb = our_pawns & rbb & fbb;
         while (bb) {
 	        if (const Square from = pop_lsb(bb); legal_ep_move(b, from, to))
-                *moves++ = make<EN_PASSANT>(from, to);
+                moves = add(moves, make<EN_PASSANT>(from, to));
         }
     }
 
     return moves;
 }
 
+template<GenType T, bool IN_CHECK, typename Out>
+Out pawn_legals(const Board &b, Out moves) {
+    return b.side_to_move() == WHITE 
+        ? pawn_legals<WHITE, T, IN_CHECK>(b, moves)
+        : pawn_legals<BLACK, T, IN_CHECK>(b, moves);
+}
+
 /*----------------End of pawn moves------------------*/
 
 /*-------------------Knight moves--------------------*/
 
-template<GenType T, bool IN_CHECK>
-ExtMove* knight_legals(const Board &b, ExtMove *moves) {
+template<GenType T, bool IN_CHECK, typename Out>
+Out knight_legals(const Board &b, Out moves) {
 	const Color us = b.side_to_move(), them = ~us;
 
     const Bitboard our_knights = b.pieces(us, KNIGHT);
@@ -150,9 +211,7 @@ ExtMove* knight_legals(const Board &b, ExtMove *moves) {
     Bitboard bb = our_knights & ~pinned;
     while (bb) {
 	    const Square from = pop_lsb(bb);
-        Bitboard dsts = attacks_bb<KNIGHT>(from) & mask;
-        while (dsts)
-            *moves++ = make_move(from, pop_lsb(dsts));
+        moves = add_all(moves, from, attacks_bb<KNIGHT>(from) & mask);
     }
 
     return moves;
@@ -162,8 +221,8 @@ ExtMove* knight_legals(const Board &b, ExtMove *moves) {
 
 /*-------------------Slider moves--------------------*/
 
-template<GenType T, PieceType P, bool IN_CHECK>
-ExtMove* slider_legals(const Board &b, ExtMove *moves) {
+template<GenType T, PieceType P, bool IN_CHECK, typename Out>
+Out slider_legals(const Board &b, Out moves) {
     static_assert(P == BISHOP || P == ROOK || P == QUEEN);
 
     const Color us = b.side_to_move(), them = ~us;
@@ -184,19 +243,16 @@ ExtMove* slider_legals(const Board &b, ExtMove *moves) {
     Bitboard bb = our_sliders & ~pinned;
     while (bb) {
         Square from = pop_lsb(bb);
-        Bitboard dsts = attacks_bb<P>(from, b.pieces()) & mask;
-        while (dsts)
-            *moves++ = make_move(from, pop_lsb(dsts));
+        moves = add_all(moves, from, 
+                attacks_bb<P>(from, b.pieces()) & mask);
     }
 
     if (!IN_CHECK) {
         bb = our_sliders & pinned;
         while (bb) {
             Square from = pop_lsb(bb);
-            Bitboard dsts = attacks_bb<P>(from, b.pieces())
-                & line_bb(from, ksq) & mask;
-            while (dsts)
-                *moves++ = make_move(from, pop_lsb(dsts));
+            moves = add_all(moves, from, attacks_bb<P>(from, b.pieces())
+                & line_bb(from, ksq) & mask);
         }
     }
 
@@ -216,8 +272,8 @@ bool legal_king_move(const Board &b, const Square to) {
     return !b.attackers_to(them, to, combined);
 }
 
-template<GenType T, bool IN_CHECK>
-ExtMove* king_legals(const Board &b, ExtMove *moves) {
+template<GenType T, bool IN_CHECK, typename Out>
+Out king_legals(const Board &b, Out moves) {
 	const Color us = b.side_to_move(), them = ~us;
     const Square from = b.king_square(us);
 
@@ -230,7 +286,7 @@ ExtMove* king_legals(const Board &b, ExtMove *moves) {
     Bitboard bb = attacks_bb<KING>(from) & mask;
     while (bb) {
 	    if (const Square to = pop_lsb(bb); legal_king_move(b, to))
-            *moves++ = make_move(from, to);
+            moves = add(moves, make_move(from, to));
     }
 
     if (IN_CHECK)
@@ -245,13 +301,13 @@ ExtMove* king_legals(const Board &b, ExtMove *moves) {
     if (cr & kingside_rights(us) && !(b.pieces() & kingside_mask)) {
 	    const auto right = static_cast<Square>(from + 2);
         if (const auto middle = static_cast<Square>(from + 1); legal_king_move(b, middle) && legal_king_move(b, right))
-            *moves++ = make<CASTLING>(from, right);
+            moves = add(moves, make<CASTLING>(from, right));
     }
     
     if (cr & queenside_rights(us) && !(b.pieces() & queenside_mask)) {
 	    const auto left = static_cast<Square>(from - 2);
         if (const auto middle = static_cast<Square>(from - 1); legal_king_move(b, middle) && legal_king_move(b, left))
-            *moves++ = make<CASTLING>(from, left);
+            moves = add(moves, make<CASTLING>(from, left));
     }
 
     return moves;
@@ -288,3 +344,50 @@ ExtMove* generate(const Board &b, ExtMove *moves) {
     return moves;
 }
 
+
+int count_legal(const Board &b) {
+    MoveCount c{};
+    if (!b.checkers()) {
+        c = pawn_legals<LEGAL, false>(b, c);
+        c = knight_legals<LEGAL, false>(b, c);
+        c = slider_legals<LEGAL, BISHOP, false>(b, c);
+        c = slider_legals<LEGAL, ROOK, false>(b, c);
+        c = slider_legals<LEGAL, QUEEN, false>(b, c);
+        c = king_legals<LEGAL, false>(b, c);
+    } else if (popcnt(b.checkers()) == 1) {
+        c = pawn_legals<LEGAL, true>(b, c);
+        c = knight_legals<LEGAL, true>(b, c);
+        c = slider_legals<LEGAL, BISHOP, true>(b, c);
+        c = slider_legals<LEGAL, ROOK, true>(b, c);
+        c = slider_legals<LEGAL, QUEEN, true>(b, c);
+        c = king_legals<LEGAL, true>(b, c);
+    } else {
+        c = king_legals<LEGAL, true>(b, c);
+    }
+
+    return c.n;
+}
+
+bool has_legal_move(const Board &b) {
+    //king first: it has moves more often than not and is the only
+    //piece that may move in double check
+    if (!b.checkers()) {
+        return king_legals<LEGAL, false>(b, MoveCount{}).n
+            || knight_legals<LEGAL, false>(b, MoveCount{}).n
+            || pawn_legals<LEGAL, false>(b, MoveCount{}).n
+            || slider_legals<LEGAL, QUEEN, false>(b, MoveCount{}).n
+            || slider_legals<LEGAL, ROOK, false>(b, MoveCount{}).n
+            || slider_legals<LEGAL, BISHOP, false>(b, MoveCount{}).n;
+    } 
+    
+    if (king_legals<LEGAL, true>(b, MoveCount{}).n)
+        return true;
+    if (popcnt(b.checkers()) > 1)
+        return false;
+
+    return knight_legals<LEGAL, true>(b, MoveCount{}).n
+        || pawn_legals<LEGAL, true>(b, MoveCount{}).n
+        || slider_legals<LEGAL, QUEEN, true>(b, MoveCount{}).n
+        || slider_legals<LEGAL, ROOK, true>(b, MoveCount{}).n
+        || slider_legals<LEGAL, BISHOP, true>(b, MoveCount{}).n;
+}
@@ -6,7 +6,7 @@
 
 struct ExtMove {
     Move move;
-    int16_t value;
+    int32_t value;
 
     operator Move() const { return move; }
     void operator=(const Move m) { move = m; }
@@ -31,4 +31,8 @@ class Board;
 template<GenType T>
 ExtMove* generate(const Board &b, ExtMove *moves);
 
+//same as generate<LEGAL>, without writing the moves out
+int count_legal(const Board &b);
+bool has_legal_move(const Board &b);
+
 #endif
@@ -316,6 +316,59 @@ static void append_changed_indices(const Position* pos, index_list removed[2],
 	}
 }
 
+// Changed features between two unrelated positions, a perspective is
+// reset when its king moved or a refresh would add fewer features
+static void append_diff_indices(const Position* prev, const Position* pos,
+	index_list removed[2], index_list added[2], bool reset[2])
+{
+	reset[0] = prev->squares[0] != pos->squares[0];
+	reset[1] = prev->squares[1] != pos->squares[1];
+
+	uint8_t before[64]{}, after[64]{};
+	int changed[64], changes = 0, count = 0;
+	if (!reset[0] || !reset[1])
+	{
+		for (int i = 2; prev->pieces[i]; i++)
+			before[prev->squares[i]] = static_cast<uint8_t>(prev->pieces[i]);
+		for (int i = 2; pos->pieces[i]; i++, count++)
+			after[pos->squares[i]] = static_cast<uint8_t>(pos->pieces[i]);
+
+		// squares with another piece, eight at a time
+		for (int s = 0; s < 64; s += 8)
+		{
+			uint64_t b, a;
+			memcpy(&b, before + s, 8);
+			memcpy(&a, after + s, 8);
+			for (uint64_t d = b ^ a; d; )
+			{
+				const int byte = bsf(d) / 8;
+				changed[changes++] = s + byte;
+				d &= ~(0xffull << byte * 8);
+			}
+		}
+	}
+
+	for (int c = 0; c < 2; c++)
+	{
+		reset[c] = reset[c] || 2 * changes >= count;
+		if (reset[c])
+		{
+			half_kp_append_active_indices(pos, c, &added[c]);
+			continue;
+		}
+
+		const int ksq = orient(c, pos->squares[c]);
+		for (int k = 0; k < changes; k++)
+		{
+			const int sq = changed[k];
+			if (before[sq])
+				removed[c].values[removed[c].size++] = make_index(c, sq, before[sq], ksq);
+			if (after[sq])
+				added[c].values[added[c].size++] = make_index(c, sq, after[sq], ksq);
+		}
+	}
+}
+
 // InputLayer = InputSlice<256 * 2>
 // out: 512 x clipped_t
 
@@ -1026,24 +1079,11 @@ INLINE void refresh_accumulator(const Position* pos)
 	accumulator->computed_accumulation = 1;
 }
 
-// Calculate cumulative value using difference calculation if possible
-INLINE bool update_accumulator(const Position* pos)
+// Accumulator from prev_acc, or from the biases where reset, and the
+// changed features
+INLINE void apply_changed_indices(Accumulator* accumulator, Accumulator* prev_acc,
+	index_list removed_indices[2], index_list added_indices[2], const bool reset[2])
 {
-	Accumulator* accumulator = &(pos->nnue[0]->accumulator);
-	if (accumulator->computed_accumulation)
-		return true;
-
-	Accumulator* prev_acc;
-	if ((!pos->nnue[1] || !(prev_acc = &pos->nnue[1]->accumulator)->computed_accumulation)
-		&& (!pos->nnue[2] || !(prev_acc = &pos->nnue[2]->accumulator)->computed_accumulation))
-		return false;
-
-	index_list removed_indices[2]{}, added_indices[2]{};
-	removed_indices[0].size = removed_indices[1].size = 0;
-	added_indices[0].size = added_indices[1].size = 0;
-	bool reset[2];
-	append_changed_indices(pos, removed_indices, added_indices, reset);
-
 #ifdef VECTOR
 	for (unsigned i = 0; i < k_half_dimensions / tile_height; i++)
 	{
@@ -1126,6 +1166,27 @@ INLINE bool update_accumulator(const Position* pos)
 #endif
 
 	accumulator->computed_accumulation = 1;
+}
+
+// Calculate cumulative value using difference calculation if possible
+INLINE bool update_accumulator(const Position* pos)
+{
+	Accumulator* accumulator = &(pos->nnue[0]->accumulator);
+	if (accumulator->computed_accumulation)
+		return true;
+
+	Accumulator* prev_acc;
+	if ((!pos->nnue[1] || !(prev_acc = &pos->nnue[1]->accumulator)->computed_accumulation)
+		&& (!pos->nnue[2] || !(prev_acc = &pos->nnue[2]->accumulator)->computed_accumulation))
+		return false;
+
+	index_list removed_indices[2]{}, added_indices[2]{};
+	removed_indices[0].size = removed_indices[1].size = 0;
+	added_indices[0].size = added_indices[1].size = 0;
+	bool reset[2];
+	append_changed_indices(pos, removed_indices, added_indices, reset);
+
+	apply_changed_indices(accumulator, prev_acc, removed_indices, added_indices, reset);
 	return true;
 }
 
@@ -1420,3 +1481,34 @@ int _CDECL nnue_evaluate(const int player, int* pieces, int* squares)
 	return nnue_evaluate_pos(&pos);
 }
 
+void _CDECL nnue_evaluate_batch(const int count, const int* players, int** pieces, int** squares, int* scores)
+{
+	// each accumulator is the starting point of the next position's one
+	nnue_data nnue[2]{};
+	Position prev{};
+
+	for (int i = 0; i < count; i++)
+	{
+		Position pos{};
+		pos.nnue[0] = &nnue[i & 1];
+		pos.player = players[i];
+		pos.pieces = pieces[i];
+		pos.squares = squares[i];
+
+		if (i == 0)
+			refresh_accumulator(&pos);
+		else
+		{
+			index_list removed_indices[2]{}, added_indices[2]{};
+			removed_indices[0].size = removed_indices[1].size = 0;
+			added_indices[0].size = added_indices[1].size = 0;
+			bool reset[2];
+			append_diff_indices(&prev, &pos, removed_indices, added_indices, reset);
+			apply_changed_indices(&nnue[i & 1].accumulator, &nnue[(i - 1) & 1].accumulator,
+				removed_indices, added_indices, reset);
+		}
+
+		scores[i] = nnue_evaluate_pos(&pos);
+		prev = pos;
+	}
+}
@@ -124,3 +124,20 @@ int _CDECL nnue_evaluate
 	int* squares                      /** Corresponding array of squares each piece stands on */
 );
 
+/**
+* Batch evaluation subroutine
+* -------------------------------------------------
+* Same as nnue_evaluate for count positions, where pieces[i], squares[i]
+* and players[i] describe position i and its score goes to scores[i].
+* The feature transformer output of each position is updated from the
+* previous one when a king stands on the same square, so batches of
+* related positions (moves from one node, games in order) are cheaper.
+*/
+void _CDECL nnue_evaluate_batch
+(
+	int count,                        /** Number of positions */
+	const int* players,               /** Side to move of each position */
+	int** pieces,                     /** Array of pieces of each position */
+	int** squares,                    /** Array of squares of each position */
+	int* scores                       /** Output, score of each position */
+);
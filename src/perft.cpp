@@ -1,7 +1,8 @@
 #include "perft.hpp"
 #include "movgen/generate.hpp"
 #include "board/board.hpp"
-#include <vector>
+#include <atomic>
+#include <memory>
 #include <thread>
 
 namespace {
@@ -23,16 +24,70 @@ constexpr PerftResult PERFT_RESULTS[] = {
 
 constexpr int N = static_cast<int>(std::size(PERFT_RESULTS));
 
-} //namespace
+/*
+ * Shared between threads without locks: an entry is accepted only if
+ * check ^ data gives back the key, so torn writes read as misses.
+ * data = nodes << 8 | depth
+ * */
+class PerftTable {
+public:
+    explicit PerftTable(const size_t mbs)
+        : size_(mbs * 1024 * 1024 / sizeof(Entry)),
+          entries_(std::make_unique<Entry[]>(size_)) {}
+
+    bool probe(const uint64_t key, const int depth, uint64_t &nodes) const {
+        const Entry &e = entries_[key % size_];
+        const uint64_t data = e.data.load(std::memory_order_relaxed);
+        if ((e.check.load(std::memory_order_relaxed) ^ data) != key
+                || static_cast<int>(data & 0xFF) != depth)
+            return false;
+        nodes = data >> 8;
+        return true;
+    }
+
+    void store(const uint64_t key, const int depth, const uint64_t nodes) {
+        Entry &e = entries_[key % size_];
+        const uint64_t data = nodes << 8 | static_cast<uint64_t>(depth);
+        e.check.store(key ^ data, std::memory_order_relaxed);
+        e.data.store(data, std::memory_order_relaxed);
+    }
+
+private:
+    struct Entry {
+        std::atomic<uint64_t> check{}, data{};
+    };
+
+    size_t size_;
+    std::unique_ptr<Entry[]> entries_;
+};
+
+uint64_t perft_hashed(const Board &b, const int depth, PerftTable *tt) {
+    if (!tt || depth <= 2)
+        return perft(b, depth);
+
+    uint64_t n = 0;
+    if (tt->probe(b.key(), depth, n))
+        return n;
 
-uint64_t perft(const Board &b, const int depth) {
     ExtMove begin[MAX_MOVES];
     const ExtMove* end = generate<LEGAL>(b, begin);
+    for (auto it = begin; it != end; ++it)
+        n += perft_hashed(b.do_move(*it), depth - 1, tt);
+
+    tt->store(b.key(), depth, n);
+    return n;
+}
+
+} //namespace
 
-    /* if (depth == 0) */
-    /*     return 1; */
+uint64_t perft(const Board &b, const int depth) {
+    if (depth <= 0)
+        return 1;
     if (depth == 1)
-        return end - begin;
+        return count_legal(b);
+
+    ExtMove begin[MAX_MOVES];
+    const ExtMove* end = generate<LEGAL>(b, begin);
 
     uint64_t n = 0;
     for (auto it = begin; it != end; ++it) {
@@ -44,27 +99,76 @@ uint64_t perft(const Board &b, const int depth) {
     return n;
 }
 
-int perft_test_positions() {
-    uint64_t results[N]{};
-    std::vector<std::thread> threads;
-    threads.reserve(N);
+std::vector<PerftDivide> perft_divide(const Board &b, const int depth,
+        const int threads, const int hash_mb)
+{
+    ExtMove begin[MAX_MOVES];
+    const ExtMove* end = generate<LEGAL>(b, begin);
 
-    for (int i = 0; i < N; ++i) {
-        threads.emplace_back([&results, i]
-        {
-	        const PerftResult pr = PERFT_RESULTS[i];
-            Board b{};
-            if (!b.load_fen(pr.fen))
-                return;
-            results[i] = perft(b, pr.depth);
-        });
+    std::vector<PerftDivide> result;
+    for (auto it = begin; it != end; ++it)
+        result.push_back({ it->move, depth <= 1 ? 1u : 0u });
+    if (depth <= 1)
+        return result;
+
+    //(root move index, position two plies down)
+    struct Task {
+        size_t root;
+        Board board;
+    };
+    std::vector<Task> tasks;
+    for (size_t i = 0; i < result.size(); ++i) {
+        const Board child = b.do_move(result[i].move);
+        if (depth == 2) {
+            result[i].nodes = count_legal(child);
+            continue;
+        }
+
+        ExtMove replies[MAX_MOVES];
+        const ExtMove* rend = generate<LEGAL>(child, replies);
+        for (auto it = replies; it != rend; ++it)
+            tasks.push_back({ i, child.do_move(*it) });
     }
 
-    for (auto &t: threads)
+    std::unique_ptr<PerftTable> tt;
+    if (hash_mb > 0)
+        tt = std::make_unique<PerftTable>(hash_mb);
+
+    //idle threads grab the next unclaimed task
+    std::atomic<size_t> next{};
+    std::vector<std::atomic<uint64_t>> nodes(result.size());
+    auto work = [&] {
+        for (size_t t = next++; t < tasks.size(); t = next++) {
+            nodes[tasks[t].root] += perft_hashed(tasks[t].board, 
+                    depth - 2, tt.get());
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; ++i)
+        pool.emplace_back(work);
+    work();
+    for (auto &t: pool)
         t.join();
 
+    if (depth > 2)
+        for (size_t i = 0; i < result.size(); ++i)
+            result[i].nodes = nodes[i];
+
+    return result;
+}
+
+int perft_test_positions(const int threads, const int hash_mb) {
     for (int i = 0; i < N; ++i) {
-        if (PERFT_RESULTS[i].nodes != results[i])
+	    const PerftResult pr = PERFT_RESULTS[i];
+        Board b{};
+        if (!b.load_fen(pr.fen))
+            return i + 1;
+
+        uint64_t nodes = 0;
+        for (auto &[m, n]: perft_divide(b, pr.depth, threads, hash_mb))
+            nodes += n;
+        if (nodes != pr.nodes)
             return i + 1;
     }
 
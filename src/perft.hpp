@@ -2,10 +2,27 @@
 #define PERFT_HPP
 
 #include <cstdint>
+#include <vector>
+#include "primitives/common.hpp"
 
 class Board;
 
+struct PerftDivide {
+    Move move;
+    uint64_t nodes;
+};
+
 uint64_t perft(const Board &b, int depth);
-int perft_test_positions();
+
+/*
+ * Node counts per root move. The positions two plies below the root
+ * are shared out to the threads, counts are cached in a hash_mb MiB
+ * table (0 disables it).
+ * */
+std::vector<PerftDivide> perft_divide(const Board &b, int depth, 
+        int threads = 1, int hash_mb = 0);
+
+//returns the 1-based index of the first failing position, 0 if all pass
+int perft_test_positions(int threads = 1, int hash_mb = 0);
 
 #endif
@@ -240,6 +240,7 @@ constexpr bool is_ok(const Move m) {
 enum : int16_t {
     VALUE_ZERO = 0,
     VALUE_MATE = 32000,
+    VALUE_TB_WIN = 31000,
     MATE_BOUND = 30000,
 };
 
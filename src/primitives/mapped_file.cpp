@@ -0,0 +1,87 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string &path) {
+    close();
+
+#ifdef _WIN32
+    const HANDLE fd = CreateFileA(path.c_str(), GENERIC_READ,
+        FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (fd == INVALID_HANDLE_VALUE)
+        return false;
+
+    DWORD hi = 0;
+    const DWORD lo = GetFileSize(fd, &hi);
+    const uint64_t size = (static_cast<uint64_t>(hi) << 32) | lo;
+    const HANDLE mh = size ? CreateFileMapping(fd, nullptr,
+        PAGE_READONLY, hi, lo, nullptr) : nullptr;
+    CloseHandle(fd);
+    if (!mh)
+        return false;
+
+    void *addr = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+    if (!addr) {
+        CloseHandle(mh);
+        return false;
+    }
+    base_ = addr;
+    mapping_ = reinterpret_cast<uint64_t>(mh);
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        return false;
+
+    struct stat st{};
+    if (fstat(fd, &st) || st.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+        return false;
+    const uint64_t size = static_cast<uint64_t>(st.st_size);
+    base_ = addr;
+    mapping_ = size;
+#endif
+
+    size_ = static_cast<size_t>(size);
+    return true;
+}
+
+void MappedFile::close() {
+    if (!base_)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(base_);
+    CloseHandle(reinterpret_cast<HANDLE>(mapping_));
+#else
+    munmap(base_, mapping_);
+#endif
+    base_ = nullptr;
+    size_ = 0;
+}
+
+const uint8_t *MappedFile::data() const {
+    return static_cast<const uint8_t*>(base_);
+}
+
+size_t MappedFile::size() const {
+    return size_;
+}
@@ -0,0 +1,30 @@
+#ifndef PRIMITIVE_MAPPED_FILE_HPP
+#define PRIMITIVE_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+//A read-only file mapped into memory, for random access into files
+//that are too large to be read up front
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    //false if the file cannot be mapped or is empty
+    bool open(const std::string &path);
+    void close();
+
+    [[nodiscard]] const uint8_t *data() const;
+    [[nodiscard]] size_t size() const;
+
+private:
+    void *base_{};
+    uint64_t mapping_{}; //the mapping handle on Windows, the length elsewhere
+    size_t size_{};
+};
+
+#endif
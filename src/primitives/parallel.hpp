@@ -0,0 +1,20 @@
+#ifndef PRIMITIVE_PARALLEL_HPP
+#define PRIMITIVE_PARALLEL_HPP
+
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+//Splits [0, n) into `threads` slices and calls f(thread, first, last)
+//for each, the first slice on the calling thread
+template<typename F>
+void parallel_for(const int threads, const size_t n, F f) {
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t)
+        pool.emplace_back([&f, t, threads, n] { f(t, n * t / threads, n * (t + 1) / threads); });
+    f(0, 0, n / threads);
+    for (auto &th: pool)
+        th.join();
+}
+
+#endif
@@ -2,6 +2,7 @@
 #include <ostream>
 #include "../parse_helpers.hpp"
 #include "../board/board.hpp"
+#include "../movgen/generate.hpp"
 
 Square square_from_str(const std::string_view sv) {
     if (sv.size() < 2)
@@ -112,6 +113,69 @@ Move move_from_str(const Board &b, const std::string_view sv) {
     return b.is_valid_move(m) ? m : MOVE_NONE;
 }
 
+Move move_from_san(const Board &b, std::string_view sv) {
+    while (!sv.empty() && (sv.back() == '+' || sv.back() == '#'
+                || sv.back() == '!' || sv.back() == '?'))
+        sv.remove_suffix(1);
+
+    ExtMove moves[MAX_MOVES];
+    const ExtMove *end = generate<LEGAL>(b, moves);
+
+    if (sv == "O-O" || sv == "0-0" || sv == "O-O-O" || sv == "0-0-0") {
+        const bool kingside = sv.size() == 3;
+        for (const ExtMove *it = moves; it != end; ++it)
+            if (type_of(it->move) == CASTLING
+                    && (to_sq(*it) > from_sq(*it)) == kingside)
+                return *it;
+        return MOVE_NONE;
+    }
+
+    PieceType pt = PAWN;
+    if (!sv.empty() && is_upper(sv.front())) {
+        pt = ptype_from_str(sv);
+        sv.remove_prefix(1);
+    }
+
+    //"e8=Q" or "e8Q"
+    PieceType prom = NO_PIECE_TYPE;
+    if (!sv.empty() && is_upper(sv.back())) {
+        prom = ptype_from_str(sv.substr(sv.size() - 1));
+        sv.remove_suffix(sv.size() >= 2 && sv[sv.size() - 2] == '=' ? 2 : 1);
+    }
+
+    if (sv.size() < 2 || pt == NO_PIECE_TYPE)
+        return MOVE_NONE;
+    const Square to = square_from_str(sv.substr(sv.size() - 2));
+    sv.remove_suffix(2);
+
+    //what is left is the disambiguation and 'x'
+    int file = -1, rank = -1;
+    for (const char ch: sv) {
+        if (ch >= 'a' && ch <= 'h')
+            file = ch - 'a';
+        else if (ch >= '1' && ch <= '8')
+            rank = ch - '1';
+    }
+
+    Move found = MOVE_NONE;
+    for (const ExtMove *it = moves; it != end; ++it) {
+        const Move m = *it;
+        const Square from = from_sq(m);
+        if (to_sq(m) != to || type_of(m) == CASTLING
+                || type_of(b.piece_on(from)) != pt
+                || (file >= 0 && file_of(from) != file)
+                || (rank >= 0 && rank_of(from) != rank))
+            continue;
+        if (type_of(m) == PROMOTION ? prom_type(m) != prom : prom != NO_PIECE_TYPE)
+            continue;
+        if (found != MOVE_NONE)
+            return MOVE_NONE;
+        found = m;
+    }
+
+    return found;
+}
+
 std::ostream& operator<<(std::ostream& os, const Square s) {
     if (!is_ok(s)) {
         os << "SQ_NONE";
@@ -28,6 +28,10 @@ Move move_from_str(std::string_view sv);
 //extracts move and tests if it is valid
 Move move_from_str(const Board &b, std::string_view sv);
 
+//standard algebraic notation ("Nbd7", "exd8=Q+", "O-O"),
+//MOVE_NONE if the move is illegal or ambiguous
+Move move_from_san(const Board &b, std::string_view sv);
+
 
 std::ostream& operator<<(std::ostream& os, Square s);
 std::ostream& operator<<(std::ostream& os, Color c);
@@ -1,6 +1,50 @@
 #include "searchstack.hpp"
 #include "board/board.hpp"
+#include "movgen/attack.hpp"
+#include "zobrist.hpp"
 #include <cstring>
+#include <utility>
+
+namespace {
+
+/*
+ * Cuckoo tables of the key differences of every reversible
+ * (non-pawn) move, used to spot a move that returns to a position
+ * seen before. See "Cuckoo hashing" by Marcel van Kervinck.
+ * */
+uint64_t CUCKOO[8192];
+Move CUCKOO_MOVE[8192];
+
+constexpr int h1(const uint64_t key) { return key & 0x1fff; }
+constexpr int h2(const uint64_t key) { return (key >> 16) & 0x1fff; }
+
+} //namespace
+
+void init_cuckoo() {
+    for (Piece p = W_KNIGHT; p < PIECE_NB; ++p) {
+        if (type_of(p) < KNIGHT || type_of(p) > KING)
+            continue;
+
+        for (Square s1 = SQ_A1; s1 <= SQ_H8; ++s1) {
+            for (Square s2 = static_cast<Square>(s1 + 1); s2 <= SQ_H8; ++s2) {
+                if (!(attacks_bb(type_of(p), s1, 0) & square_bb(s2)))
+                    continue;
+
+                Move move = make_move(s1, s2);
+                uint64_t key = ZOBRIST.psq[p][s1] ^ ZOBRIST.psq[p][s2] 
+                    ^ ZOBRIST.side;
+                int i = h1(key);
+                while (true) {
+                    std::swap(CUCKOO[i], key);
+                    std::swap(CUCKOO_MOVE[i], move);
+                    if (move == MOVE_NONE)
+                        break;
+                    i = i == h1(key) ? h2(key) : h1(key);
+                }
+            }
+        }
+    }
+}
 
 void Stack::set_start(const int start) { 
     start_ = start; 
@@ -12,12 +56,15 @@ void Stack::reset() {
     memset(entries_.data(), 0, sizeof(entries_));
 }
 
-void Stack::push(const uint64_t key, const Move m, const int16_t eval) {
-    entries_[height_++] = { 
-        key, m, 
-        { MOVE_NONE, MOVE_NONE }, 
-        eval 
-    };
+void Stack::push(const uint64_t key, const Move m, const int16_t eval,
+        const Piece moved) 
+{
+    //killers are kept: they belong to the ply, not to the move
+    auto &e = entries_[height_++];
+    e.key = key;
+    e.move = m;
+    e.eval = eval;
+    e.moved = moved;
 }
 
 void Stack::pop() {
@@ -46,6 +93,45 @@ bool Stack::is_repetition(const Board &b) const {
     return false;
 }
 
+bool Stack::has_repeated(const Board &b) const {
+    const int halfmoves = std::min(b.half_moves(), 
+                                   b.plies_from_null());
+    const int k = std::max(0, height_ - halfmoves);
+    //b comes after the last entry
+    auto key_at = [&](const int i) {
+        return i == height_ ? b.key() : entries_[i].key;
+    };
+    for (int i = height_; i >= k + 4; --i)
+        for (int j = i - 4; j >= k; j -= 2)
+            if (key_at(j) == key_at(i))
+                return true;
+    return false;
+}
+
+bool Stack::has_upcoming_repetition(const Board &b) const {
+    const int end = std::min(b.half_moves(), b.plies_from_null());
+    const int ply = height();
+    if (end < 3)
+        return false;
+
+    //the game history is on the stack below the root, but only cycles
+    //within the search tree count: a move back to a game position
+    //repeats it only twice, a draw needs that position to repeat already
+    for (int i = 3; i <= end && i < ply; i += 2) {
+        const uint64_t diff = b.key() ^ entries_[height_ - i].key;
+
+        int j = h1(diff);
+        if (CUCKOO[j] != diff && CUCKOO[j = h2(diff)] != diff)
+            continue;
+
+        const Move m = CUCKOO_MOVE[j];
+        if (!(between_bb(from_sq(m), to_sq(m)) & b.pieces()))
+            return true;
+    }
+
+    return false;
+}
+
 int16_t Stack::mated_score() const {
     return mated_in(height());
 }
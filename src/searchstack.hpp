@@ -14,6 +14,7 @@ public:
         Move move;
         Move killers[2];
         int16_t eval;
+        Piece moved;
     };
 
     Stack() = default;
@@ -21,7 +22,8 @@ public:
     void set_start(int start);
     void reset();
 
-    void push(uint64_t key, Move m = MOVE_NONE, int16_t eval = 0);
+    void push(uint64_t key, Move m = MOVE_NONE, int16_t eval = 0,
+            Piece moved = NO_PIECE);
     void pop();
 
     Entry &at(int ply);
@@ -31,6 +33,10 @@ public:
     [[nodiscard]] bool capped() const;
 
     [[nodiscard]] bool is_repetition(const Board &b) const;
+    //a position since the last zeroing move, b included, occurred twice
+    [[nodiscard]] bool has_repeated(const Board &b) const;
+    //a reversible move would bring us back to a position on the stack
+    [[nodiscard]] bool has_upcoming_repetition(const Board &b) const;
 
     [[nodiscard]] int16_t mated_score() const;
 
@@ -39,4 +45,6 @@ private:
     int height_{}, start_{};
 };
 
+void init_cuckoo();
+
 #endif
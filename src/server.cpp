@@ -0,0 +1,339 @@
+#include "server.hpp"
+#include "cli.hpp"
+#include "tt.hpp"
+#include "primitives/utility.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <csignal>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+/*
+ * FILE: server.cpp
+ * One thread polls the listening socket and the connections and parses
+ * the commands, the pool threads run the searches and write the replies.
+ * "go" copies the session's position into a job, so that a later
+ * "position" does not touch a running search. A session is queued once
+ * however many "go"s it sends (the last one wins), which keeps
+ * a client that floods the server from starving the others.
+ * */
+
+#ifdef _WIN32
+
+void serve(const std::string &path, int threads) {
+    (void)(path);
+    (void)(threads);
+    sync_cout() << "info string serve: unix domain sockets are not supported\n";
+}
+
+#else
+
+namespace {
+
+//a search must end on its own to give the pool thread back
+constexpr int DEFAULT_MOVETIME = 1000;
+
+struct Job {
+    Board board;
+    Stack st;
+    SearchLimits limits;
+};
+
+struct Session {
+    explicit Session(const int socket_fd)
+        : fd(socket_fd) {}
+
+    ~Session() {
+        close(fd);
+    }
+
+    void send(const std::string &s) {
+        std::lock_guard lock(write_mtx);
+        for (size_t sent = 0; sent < s.size(); ) {
+            const ssize_t n = ::send(fd, s.data() + sent, s.size() - sent, 0);
+            if (n <= 0)
+                return;
+            sent += static_cast<size_t>(n);
+        }
+    }
+
+    const int fd;
+    std::mutex write_mtx;
+
+    //used by the polling thread only
+    std::string input;
+    Board board = Board::start_pos();
+    Stack st;
+
+    //guarded by Server::mutex_
+    std::optional<Job> pending;
+    SearchWorker *running{};
+    bool stop_requested{}; //"stop" for the running search
+    bool closed{};
+};
+
+using SessionPtr = std::shared_ptr<Session>;
+
+class Server {
+public:
+    Server(int listen_fd, int threads);
+    ~Server();
+
+    void run();
+
+private:
+    bool execute(const SessionPtr &s, const std::string &line);
+    void go(const SessionPtr &s, std::istream &is);
+    void stop(const SessionPtr &s, bool closed);
+    void work(SearchWorker &worker);
+
+    const int listen_fd_;
+    std::vector<SessionPtr> sessions_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<SessionPtr> queue_;
+    bool done_{};
+
+    std::vector<std::unique_ptr<SearchWorker>> workers_;
+    std::vector<std::thread> pool_;
+};
+
+Server::Server(const int listen_fd, const int threads)
+    : listen_fd_(listen_fd)
+{
+    for (int i = 0; i < threads; ++i)
+        workers_.push_back(std::make_unique<SearchWorker>());
+    for (auto &w: workers_)
+        pool_.emplace_back([this, &w] { work(*w); });
+}
+
+Server::~Server() {
+    {
+        std::lock_guard lock(mutex_);
+        done_ = true;
+        for (auto &s: sessions_)
+            if (s->running)
+                s->running->stop();
+    }
+    cv_.notify_all();
+    for (auto &t: pool_)
+        t.join();
+    close(listen_fd_);
+}
+
+void Server::work(SearchWorker &worker) {
+    std::ostringstream ss;
+    while (true) {
+        SessionPtr s;
+        Job job;
+        {
+            std::unique_lock lock(mutex_);
+            cv_.wait(lock, [this] { return done_ || !queue_.empty(); });
+            if (done_)
+                return;
+            s = std::move(queue_.front());
+            queue_.pop_front();
+            job = std::move(*s->pending);
+            s->pending.reset();
+            s->running = &worker;
+            s->stop_requested = false;
+        }
+
+        //the time counts from the start, not from the "go"
+        job.limits.start = timer::now();
+        worker.go(job.board, job.st, job.limits);
+        {
+            //go() clears a stop() that came after the job was taken
+            std::lock_guard lock(mutex_);
+            if (s->stop_requested || s->closed || done_)
+                worker.stop();
+        }
+        worker.wait_for_completion();
+
+        ss.str("");
+        ss.clear();
+        if (!worker.iterations().empty()) {
+            const IterationStats &it = worker.iterations().back();
+            Move pv[MAX_DEPTH]{};
+            const int pv_len = g_tt.extract_pv(job.board, pv, it.depth);
+            ss << "info score " << Score{it.score}
+               << " depth " << it.depth
+               << " nodes " << it.nodes
+               << " time " << it.time
+               << " pv ";
+            for (int i = 0; i < pv_len; ++i)
+                ss << pv[i] << ' ';
+            ss << '\n';
+        }
+        ss << "bestmove " << worker.best_move() << '\n';
+
+        bool closed;
+        {
+            std::lock_guard lock(mutex_);
+            s->running = nullptr;
+            closed = s->closed;
+        }
+        //a slow reader only holds up its own session
+        if (!closed)
+            s->send(ss.str());
+    }
+}
+
+void Server::go(const SessionPtr &s, std::istream &is) {
+    Job job{ s->board, s->st, {} };
+    SearchLimits &limits = job.limits;
+    std::string token;
+    while (is >> token) {
+        if (token == "movetime") is >> limits.move_time;
+        else if (token == "depth") is >> limits.max_depth;
+        else if (token == "nodes") is >> limits.nodes;
+    }
+    limits.max_depth = std::clamp(limits.max_depth, 1, MAX_DEPTH);
+    limits.silent = true;
+    if (!limits.move_time && limits.max_depth == MAX_DEPTH && !limits.nodes)
+        limits.move_time = DEFAULT_MOVETIME;
+    limits.infinite = !limits.move_time;
+
+    {
+        std::lock_guard lock(mutex_);
+        if (!s->pending)
+            queue_.push_back(s);
+        s->pending = std::move(job);
+    }
+    cv_.notify_one();
+}
+
+//drops the waiting search and ends the running one
+void Server::stop(const SessionPtr &s, const bool closed) {
+    bool dropped = false;
+    {
+        std::lock_guard lock(mutex_);
+        s->closed = closed;
+        if (s->pending) {
+            s->pending.reset();
+            queue_.erase(std::find(queue_.begin(), queue_.end(), s));
+            dropped = true;
+        }
+        if (s->running) {
+            s->stop_requested = true;
+            s->running->stop();
+        }
+    }
+    if (dropped && !closed)
+        s->send("bestmove 0000\n");
+}
+
+//returns false on "quit"
+bool Server::execute(const SessionPtr &s, const std::string &line) {
+    std::istringstream is(line);
+    std::string cmd;
+    is >> cmd;
+
+    if (cmd == "isready") s->send("readyok\n");
+    else if (cmd == "go") go(s, is);
+    else if (cmd == "stop") stop(s, false);
+    else if (cmd == "position") {
+        Board b{};
+        Stack st;
+        if (read_position(is, b, st)) {
+            s->board = b;
+            s->st = st;
+        } else {
+            s->send("info string invalid position\n");
+        }
+    }
+    else if (cmd == "quit") return false;
+    else if (!cmd.empty()) s->send("info string unknown command " + cmd + '\n');
+
+    return true;
+}
+
+void Server::run() {
+    std::vector<pollfd> fds;
+    char buf[4096];
+    while (true) {
+        fds.assign(1, { listen_fd_, POLLIN, 0 });
+        for (auto &s: sessions_)
+            fds.push_back({ s->fd, POLLIN, 0 });
+
+        if (poll(fds.data(), fds.size(), -1) < 0)
+            continue;
+
+        //fds[i + 1] belongs to sessions_[i], new sessions are appended
+        for (size_t i = fds.size() - 1; i > 0; --i) {
+            if (!fds[i].revents)
+                continue;
+
+            const SessionPtr s = sessions_[i - 1];
+            const ssize_t n = recv(s->fd, buf, sizeof(buf), 0);
+            bool open = n > 0;
+            if (open)
+                s->input.append(buf, static_cast<size_t>(n));
+
+            for (size_t eol; open && (eol = s->input.find('\n')) != std::string::npos; ) {
+                std::string line = s->input.substr(0, eol);
+                s->input.erase(0, eol + 1);
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+                open = execute(s, line);
+            }
+
+            if (!open) {
+                stop(s, true);
+                sessions_.erase(sessions_.begin() + static_cast<ptrdiff_t>(i - 1));
+            }
+        }
+
+        if (fds[0].revents & POLLIN)
+            if (const int fd = accept(listen_fd_, nullptr, nullptr); fd >= 0)
+                sessions_.push_back(std::make_shared<Session>(fd));
+    }
+}
+
+} //namespace
+
+void serve(const std::string &path, int threads) {
+    sockaddr_un addr{};
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        sync_cout() << "info string serve: bad socket path " << path << '\n';
+        return;
+    }
+    addr.sun_family = AF_UNIX;
+    std::copy(path.begin(), path.end(), addr.sun_path);
+
+    //a socket left behind by a previous server, never any other file
+    if (struct stat st{}; lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path.c_str());
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0
+            || listen(fd, 64) < 0) {
+        sync_cout() << "info string serve: cannot listen on " << path << '\n';
+        if (fd >= 0)
+            close(fd);
+        return;
+    }
+
+    //a client that hangs up must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+
+    threads = std::max(threads, 1);
+    sync_cout() << "info string serve: listening on " << path
+                << " with " << threads << " threads\n";
+    Server(fd, threads).run();
+}
+
+#endif
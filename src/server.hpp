@@ -0,0 +1,19 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include <string>
+
+/*
+ * Analysis server on a Unix domain socket. Every connection is a session
+ * with its own position that speaks a subset of UCI:
+ *   position startpos | fen <fen> [moves ...]
+ *   go [depth N] [movetime N] [nodes N]
+ *   stop, isready, quit
+ * Searches of all sessions run on a fixed pool of `threads` workers and
+ * share g_tt and the network; a session has at most one search waiting,
+ * and waiting sessions are served in turn.
+ * Blocks until the process is killed.
+ * */
+void serve(const std::string &path, int threads);
+
+#endif
@@ -0,0 +1,185 @@
+#include "tbprobe.hpp"
+#include "../board/board.hpp"
+#include "../movgen/generate.hpp"
+#include <sstream>
+#include <vector>
+
+/*
+ * FILE: tbcheck.cpp
+ * The decoder is checked against values it does not compute itself:
+ * KXvK is solved by retrograde analysis with the move generator
+ * (mate is a loss in 0 plies, a win is 1 + the fastest loss among
+ * the children, a loss 1 + the slowest win), every legal position is
+ * probed with either colour as the strong side, and WDL and DTZ must
+ * match the solution.
+ * */
+
+namespace syzygy {
+namespace {
+
+constexpr int8_t UNKNOWN = -2, LOSS = -1, DRAW = 0, WIN = 1;
+constexpr int STATES = 2 * 64 * 64 * 64;
+//the lone king took the piece
+constexpr int CAPTURED = -1;
+
+struct Solution {
+    std::vector<int8_t> result = std::vector<int8_t>(STATES, UNKNOWN);
+    std::vector<uint8_t> plies = std::vector<uint8_t>(STATES, 0);
+};
+
+//white is the strong side, index of stm, wk, bk and the piece
+int state_index(const int stm, const int wk, const int bk, const int sq) {
+    return ((stm * 64 + wk) * 64 + bk) * 64 + sq;
+}
+
+//the position of state i with `strong` as the strong side,
+//the board mirrored vertically when that is black
+bool load_state(Board &b, const int i, const PieceType pt, const Color strong) {
+    const int sq = i & 63, bk = (i >> 6) & 63, wk = (i >> 12) & 63;
+    const Color stm = (i >> 18) ? BLACK : WHITE;
+    if (sq == wk || sq == bk || wk == bk)
+        return false;
+
+    const int flip = strong == WHITE ? 0 : 56;
+    char mailbox[64]{};
+    mailbox[wk ^ flip] = strong == WHITE ? 'K' : 'k';
+    mailbox[bk ^ flip] = strong == WHITE ? 'k' : 'K';
+    const char piece = " pnbrq"[pt];
+    mailbox[sq ^ flip] = strong == WHITE ? static_cast<char>(piece - 32) : piece;
+
+    std::ostringstream fen;
+    for (int r = 7; r >= 0; --r) {
+        for (int f = 0, empty = 0; f < 8; ++f) {
+            if (const char c = mailbox[r * 8 + f]; c) {
+                if (empty)
+                    fen << empty;
+                fen << c;
+                empty = 0;
+            } else if (++empty, f == 7) {
+                fen << empty;
+            }
+        }
+        if (r)
+            fen << '/';
+    }
+    fen << ((stm == WHITE) == (strong == WHITE) ? " w" : " b") << " - - 0 1";
+    if (!b.load_fen(fen.str()))
+        return false;
+
+    //the side that just moved must not be in check
+    const Color them = ~b.side_to_move();
+    return !b.attackers_to(b.side_to_move(), b.king_square(them), b.pieces());
+}
+
+Solution solve(const PieceType pt) {
+    Solution sol;
+    std::vector<int> first(STATES + 1, 0), children;
+
+    for (int i = 0; i < STATES; ++i) {
+        first[i] = static_cast<int>(children.size());
+        Board b{};
+        if (!load_state(b, i, pt, WHITE))
+            continue;
+
+        ExtMove moves[MAX_MOVES];
+        const ExtMove *end = generate<LEGAL>(b, moves);
+        if (end == moves) {
+            sol.result[i] = b.checkers() ? LOSS : DRAW;
+            continue;
+        }
+
+        for (const ExtMove *m = moves; m != end; ++m) {
+            const Board bb = b.do_move(*m);
+            if (popcnt(bb.pieces()) < 3) {
+                children.push_back(CAPTURED);
+                continue;
+            }
+            children.push_back(state_index(bb.side_to_move() == BLACK,
+                bb.king_square(WHITE), bb.king_square(BLACK),
+                lsb(bb.pieces() & ~bb.pieces(KING))));
+        }
+    }
+    first[STATES] = static_cast<int>(children.size());
+
+    //odd plies are wins, even plies losses
+    for (int ply = 1, quiet = 0; quiet < 2; ++ply) {
+        ++quiet;
+        for (int i = 0; i < STATES; ++i) {
+            if (sol.result[i] != UNKNOWN || first[i] == first[i + 1])
+                continue;
+
+            bool all_won = true, found = false;
+            for (int k = first[i]; k < first[i + 1]; ++k) {
+                const int c = children[k];
+                const int8_t r = c == CAPTURED ? DRAW : sol.result[c];
+                if (r == LOSS && sol.plies[c] == ply - 1)
+                    found = true;
+                all_won &= r == WIN && sol.plies[c] < ply;
+            }
+
+            if (ply % 2 ? found : all_won) {
+                sol.result[i] = ply % 2 ? WIN : LOSS;
+                sol.plies[i] = static_cast<uint8_t>(ply);
+                quiet = 0;
+            }
+        }
+    }
+
+    return sol;
+}
+
+} //namespace
+
+CheckResult check_tables() {
+    CheckResult res;
+    constexpr PieceType CHECKED[] = { QUEEN, ROOK, BISHOP, KNIGHT };
+
+    for (const PieceType pt: CHECKED) {
+        Board probe{};
+        ProbeState state;
+        //white Kc1, black Ka8, the piece on h2, black to move
+        if (!load_state(probe, state_index(1, 2, 56, 15), pt, WHITE)
+                || (probe_wdl(probe, state), state == PROBE_FAIL))
+            continue;
+
+        const Solution sol = solve(pt);
+        ++res.tables;
+
+        for (int i = 0; i < STATES; ++i) {
+            for (const Color strong: { WHITE, BLACK }) {
+                Board b{};
+                if (!load_state(b, i, pt, strong))
+                    continue;
+                ++res.positions;
+
+                const int8_t r = sol.result[i] == UNKNOWN ? DRAW : sol.result[i];
+                const int wdl = probe_wdl(b, state);
+                bool ok = state != PROBE_FAIL && wdl == 2 * r;
+
+                //mated positions have no distance to check, DTZ stored
+                //in moves instead of plies may be one ply longer
+                if (ok && r != DRAW && sol.plies[i]) {
+                    const int dtz = probe_dtz(b, state) * r;
+                    ok = state != PROBE_FAIL
+                        && (dtz == sol.plies[i] || dtz == sol.plies[i] + 1);
+                } else if (ok && r == DRAW) {
+                    ok = probe_dtz(b, state) == 0 && state != PROBE_FAIL;
+                }
+
+                if (!ok && !res.mismatches++) {
+                    ProbeState st;
+                    std::ostringstream ss;
+                    ss << b.fen() << " expected wdl " << 2 * r
+                       << " plies " << int{sol.plies[i]}
+                       << ", probed wdl " << probe_wdl(b, st)
+                       << " dtz " << probe_dtz(b, st);
+                    res.first_mismatch = ss.str();
+                }
+            }
+        }
+    }
+
+    return res;
+}
+
+} //namespace syzygy
@@ -0,0 +1,1061 @@
+/*
+  This code is adapted from the Syzygy probing code of Stockfish
+  (src/syzygy/tbprobe.cpp, Ronald de Man and the Stockfish developers):
+  https://github.com/official-stockfish/Stockfish
+  It is licensed under the GNU General Public License version 3 or later.
+
+  It has been modified as follows:
+  tables are read byte by byte instead of through endian-swapping casts
+  the Position class replaced with this engine's Board and move generator
+  root ranking takes the game history from a search Stack
+*/
+
+#include "tbprobe.hpp"
+#include "../board/board.hpp"
+#include "../movgen/attack.hpp"
+#include "../movgen/generate.hpp"
+#include "../searchstack.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+ * FILE: tbprobe.cpp
+ * Decoder for the Syzygy tablebase format (https://github.com/syzygy1/tb).
+ * A table maps a position to an index (pieces are grouped and every group
+ * is encoded as a combination of squares, using the board symmetries),
+ * the values are compressed in blocks with Huffman-coded pairs of symbols.
+ * The layout follows the reference probing code, with the files read
+ * byte by byte so that nothing depends on the host endianness.
+ * */
+
+namespace syzygy {
+namespace {
+
+constexpr int TB_PIECES = 7;
+
+enum TBType : uint8_t { WDL, DTZ };
+
+//PairsData::flags
+enum : uint8_t {
+    TB_STM = 1,
+    TB_MAPPED = 2,
+    TB_WIN_PLIES = 4,
+    TB_LOSS_PLIES = 8,
+    TB_WIDE = 16,
+    TB_SINGLE_VALUE = 128,
+};
+
+int MAP_PAWNS[SQUARE_NB];
+int MAP_B1H1H7[SQUARE_NB];
+int MAP_A1D1D4[SQUARE_NB];
+int MAP_KK[10][SQUARE_NB];
+
+uint64_t BINOMIAL[6][SQUARE_NB];
+uint64_t LEAD_PAWN_IDX[6][SQUARE_NB];
+uint64_t LEAD_PAWNS_SIZE[6][4];
+
+template<typename T>
+T read_le(const uint8_t *p) {
+    T v = 0;
+    for (size_t i = 0; i < sizeof(T); ++i)
+        v |= static_cast<T>(static_cast<T>(p[i]) << (8 * i));
+    return v;
+}
+
+template<typename T>
+T read_be(const uint8_t *p) {
+    T v = 0;
+    for (size_t i = 0; i < sizeof(T); ++i)
+        v = static_cast<T>((v << 8) | p[i]);
+    return v;
+}
+
+//symbols are pairs of 12 bit children packed in 3 bytes
+uint16_t left_sym(const uint8_t *btree, const uint16_t s) {
+    const uint8_t *lr = btree + 3 * s;
+    return static_cast<uint16_t>(((lr[1] & 0xF) << 8) | lr[0]);
+}
+
+uint16_t right_sym(const uint8_t *btree, const uint16_t s) {
+    const uint8_t *lr = btree + 3 * s;
+    return static_cast<uint16_t>((lr[2] << 4) | (lr[1] >> 4));
+}
+
+struct PairsData {
+    uint8_t flags;
+    size_t block_size;
+    size_t span; //there is a sparse index entry every span values
+    uint32_t num_blocks;
+    uint32_t block_length_size;
+    int max_sym_len;
+    int min_sym_len; //the value itself for TB_SINGLE_VALUE
+    const uint8_t *lowest_sym;
+    const uint8_t *btree;
+    const uint8_t *block_length;
+    const uint8_t *sparse_index;
+    size_t sparse_index_size;
+    const uint8_t *data;
+    std::vector<uint64_t> base64;
+    std::vector<uint8_t> sym_len;
+    Piece pieces[TB_PIECES];
+    uint64_t group_idx[TB_PIECES + 1];
+    int group_len[TB_PIECES + 1];
+    uint16_t map_idx[4]; //DTZ only: win, loss, cursed win, blessed loss
+};
+
+struct Table {
+    std::atomic<bool> ready{};
+    void *base{};
+    uint64_t mapping{};
+    const uint8_t *map{}; //DTZ only
+    PairsData items[2][4]; //[stm][file of the leading pawn]
+};
+
+struct Entry {
+    std::string name; //e.g. "KRvK", the stronger side first
+    uint64_t key, key2; //mat_key with the stronger side white/black
+    int piece_count;
+    bool has_pawns;
+    bool has_unique_pieces;
+    uint8_t pawn_count[2]; //[leading color, other color]
+    Table tables[2]; //[WDL, DTZ]
+
+    PairsData *get(const TBType type, const int stm, const int f) {
+        return &tables[type].items[type == WDL ? stm : 0][has_pawns ? f : 0];
+    }
+};
+
+std::deque<Entry> ENTRIES;
+std::unordered_map<uint64_t, Entry*> BY_KEY;
+std::vector<std::string> PATHS;
+int MAX_PIECES;
+std::mutex MAP_MUTEX;
+
+constexpr int off_a1h8(const Square s) {
+    return static_cast<int>(rank_of(s)) - file_of(s);
+}
+
+constexpr Square flip_file(const Square s) {
+    return static_cast<Square>(s ^ 7);
+}
+
+constexpr Square flip_rank(const Square s) {
+    return static_cast<Square>(s ^ 56);
+}
+
+constexpr int sign_of(const int x) {
+    return (x > 0) - (x < 0);
+}
+
+bool pawns_comp(const Square a, const Square b) {
+    return MAP_PAWNS[a] < MAP_PAWNS[b];
+}
+
+void init_indices() {
+    int code = 0;
+    for (Square s = SQ_A1; s <= SQ_H8; ++s)
+        if (off_a1h8(s) < 0)
+            MAP_B1H1H7[s] = code++;
+
+    //a1-d1-d4 triangle, the diagonal squares come last
+    std::vector<Square> diagonal;
+    code = 0;
+    for (Square s = SQ_A1; s <= SQ_D4; ++s) {
+        if (off_a1h8(s) < 0 && file_of(s) <= FILE_D)
+            MAP_A1D1D4[s] = code++;
+        else if (!off_a1h8(s) && file_of(s) <= FILE_D)
+            diagonal.push_back(s);
+    }
+    for (const Square s: diagonal)
+        MAP_A1D1D4[s] = code++;
+
+    //the 462 legal placements of two kings with the first one
+    //in the triangle, both on the diagonal come last
+    std::vector<std::pair<int, Square>> both_on_diagonal;
+    code = 0;
+    for (int idx = 0; idx < 10; ++idx) {
+        for (Square s1 = SQ_A1; s1 <= SQ_D4; ++s1) {
+            if (MAP_A1D1D4[s1] != idx || (!idx && s1 != SQ_B1))
+                continue;
+            for (Square s2 = SQ_A1; s2 <= SQ_H8; ++s2) {
+                if ((attacks_bb<KING>(s1) | square_bb(s1)) & square_bb(s2))
+                    continue;
+                if (!off_a1h8(s1) && off_a1h8(s2) > 0)
+                    continue;
+                if (!off_a1h8(s1) && !off_a1h8(s2))
+                    both_on_diagonal.emplace_back(idx, s2);
+                else
+                    MAP_KK[idx][s2] = code++;
+            }
+        }
+    }
+    for (const auto &[idx, s]: both_on_diagonal)
+        MAP_KK[idx][s] = code++;
+
+    BINOMIAL[0][0] = 1;
+    for (int n = 1; n < 64; ++n)
+        for (int k = 0; k < 6 && k <= n; ++k)
+            BINOMIAL[k][n] = (k > 0 ? BINOMIAL[k - 1][n - 1] : 0)
+                + (k < n ? BINOMIAL[k][n - 1] : 0);
+
+    //MAP_PAWNS[] numbers a2-h7 so that the leading pawn (the one
+    //nearest to the edge, then the lowest) has the highest value
+    int available = 47;
+    for (int lead = 1; lead <= 5; ++lead) {
+        for (File f = FILE_A; f <= FILE_D; ++f) {
+            uint64_t idx = 0;
+            for (Rank r = RANK_2; r <= RANK_7; ++r) {
+                const Square s = make_square(f, r);
+                if (lead == 1) {
+                    MAP_PAWNS[s] = available--;
+                    MAP_PAWNS[flip_file(s)] = available--;
+                }
+                LEAD_PAWN_IDX[lead][s] = idx;
+                idx += BINOMIAL[lead - 1][MAP_PAWNS[s]];
+            }
+            LEAD_PAWNS_SIZE[lead][f] = idx;
+        }
+    }
+}
+
+uint64_t material_key(const std::string &code, Color c) {
+    Board b{};
+    Square s = SQ_A1;
+    for (const char ch: code) {
+        if (ch == 'v') {
+            c = ~c;
+            continue;
+        }
+        const auto pt = static_cast<PieceType>(
+            std::string_view(" PNBRQK").find(ch));
+        b.put_piece(make_piece(c, pt), s);
+        ++s;
+    }
+    return b.mat_key();
+}
+
+bool file_exists(const std::string &name) {
+    return std::any_of(PATHS.begin(), PATHS.end(),
+        [&name](const std::string &dir) {
+            return std::ifstream(dir + "/" + name).is_open();
+        });
+}
+
+void add(const std::string &code) {
+    if (!file_exists(code + ".rtbw"))
+        return;
+
+    Entry &e = ENTRIES.emplace_back();
+    e.name = code;
+    e.key = material_key(code, WHITE);
+    e.key2 = material_key(code, BLACK);
+    e.piece_count = static_cast<int>(code.size()) - 1;
+
+    const size_t v = code.find('v');
+    const std::string strong = code.substr(0, v), weak = code.substr(v);
+    e.has_pawns = code.find('P') != std::string::npos;
+    e.has_unique_pieces = false;
+    for (const std::string *side: { &strong, &weak }) {
+        for (const char ch: std::string_view("PNBRQ"))
+            e.has_unique_pieces |= std::count(side->begin(),
+                                              side->end(), ch) == 1;
+    }
+
+    //the side with fewer pawns leads, it compresses better
+    const auto wp = static_cast<uint8_t>(
+        std::count(strong.begin(), strong.end(), 'P'));
+    const auto bp = static_cast<uint8_t>(
+        std::count(weak.begin(), weak.end(), 'P'));
+    const bool white_leads = !bp || (wp && bp >= wp);
+    e.pawn_count[0] = white_leads ? wp : bp;
+    e.pawn_count[1] = white_leads ? bp : wp;
+
+    MAX_PIECES = std::max(MAX_PIECES, e.piece_count);
+    BY_KEY[e.key] = BY_KEY[e.key2] = &e;
+}
+
+void add_all() {
+    const auto pc = [](const int pt) { return " PNBRQK"[pt]; };
+    const std::string K = "K";
+
+    for (int p1 = PAWN; p1 < KING; ++p1) {
+        add(K + pc(p1) + "vK");
+        for (int p2 = PAWN; p2 <= p1; ++p2) {
+            add(K + pc(p1) + pc(p2) + "vK");
+            add(K + pc(p1) + "vK" + pc(p2));
+            for (int p3 = PAWN; p3 < KING; ++p3)
+                add(K + pc(p1) + pc(p2) + "vK" + pc(p3));
+            for (int p3 = PAWN; p3 <= p2; ++p3) {
+                add(K + pc(p1) + pc(p2) + pc(p3) + "vK");
+                for (int p4 = PAWN; p4 <= p3; ++p4) {
+                    add(K + pc(p1) + pc(p2) + pc(p3) + pc(p4) + "vK");
+                    for (int p5 = PAWN; p5 <= p4; ++p5)
+                        add(K + pc(p1) + pc(p2) + pc(p3) + pc(p4) + pc(p5) + "vK");
+                    for (int p5 = PAWN; p5 < KING; ++p5)
+                        add(K + pc(p1) + pc(p2) + pc(p3) + pc(p4) + "vK" + pc(p5));
+                }
+                for (int p4 = PAWN; p4 < KING; ++p4) {
+                    add(K + pc(p1) + pc(p2) + pc(p3) + "vK" + pc(p4));
+                    for (int p5 = PAWN; p5 <= p4; ++p5)
+                        add(K + pc(p1) + pc(p2) + pc(p3) + "vK" + pc(p4) + pc(p5));
+                }
+            }
+            for (int p3 = PAWN; p3 <= p1; ++p3)
+                for (int p4 = PAWN; p4 <= (p1 == p3 ? p2 : p3); ++p4)
+                    add(K + pc(p1) + pc(p2) + "vK" + pc(p3) + pc(p4));
+        }
+    }
+}
+
+void unmap(const Table &t) {
+    if (!t.base)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(t.base);
+    CloseHandle(reinterpret_cast<HANDLE>(t.mapping));
+#else
+    munmap(t.base, t.mapping);
+#endif
+}
+
+//returns the data past the magic, nullptr if the file is missing or broken
+const uint8_t *map_file(const std::string &name, const TBType type,
+        void *&base, uint64_t &mapping)
+{
+    constexpr uint8_t MAGIC[2][4] = {
+        { 0x71, 0xE8, 0x23, 0x5D },
+        { 0xD7, 0x66, 0x0C, 0xA5 },
+    };
+
+    for (const auto &dir: PATHS) {
+        const std::string path = dir + "/" + name;
+#ifdef _WIN32
+        const HANDLE fd = CreateFileA(path.c_str(), GENERIC_READ,
+            FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_FLAG_RANDOM_ACCESS, nullptr);
+        if (fd == INVALID_HANDLE_VALUE)
+            continue;
+
+        DWORD hi = 0;
+        const DWORD lo = GetFileSize(fd, &hi);
+        const uint64_t size = (static_cast<uint64_t>(hi) << 32) | lo;
+        const HANDLE mh = size % 64 == 16 ? CreateFileMapping(fd, nullptr,
+            PAGE_READONLY, hi, lo, nullptr) : nullptr;
+        CloseHandle(fd);
+        if (!mh)
+            return nullptr;
+
+        void *addr = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+        if (!addr) {
+            CloseHandle(mh);
+            return nullptr;
+        }
+        base = addr;
+        mapping = reinterpret_cast<uint64_t>(mh);
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd == -1)
+            continue;
+
+        struct stat st{};
+        if (fstat(fd, &st) || st.st_size % 64 != 16) {
+            ::close(fd);
+            return nullptr;
+        }
+
+        void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED)
+            return nullptr;
+#ifdef MADV_RANDOM
+        madvise(addr, st.st_size, MADV_RANDOM);
+#endif
+        base = addr;
+        mapping = static_cast<uint64_t>(st.st_size);
+#endif
+
+        const auto *data = static_cast<const uint8_t*>(base);
+        if (memcmp(data, MAGIC[type], 4)) {
+            Table t;
+            t.base = base;
+            t.mapping = mapping;
+            unmap(t);
+            base = nullptr;
+            return nullptr;
+        }
+        return data + 4;
+    }
+
+    return nullptr;
+}
+
+/*
+ * Groups are the runs of pieces encoded together: the leading group
+ * (kings and possibly a third unique piece, or the leading pawns),
+ * the remaining pawns and then every run of identical pieces.
+ * order[] tells in which order the groups are multiplied out.
+ * */
+void set_groups(const Entry &e, PairsData *d, const int *order, const File f) {
+    int n = 0, first_len = e.has_pawns ? 0 : e.has_unique_pieces ? 3 : 2;
+    d->group_len[n] = 1;
+    for (int i = 1; i < e.piece_count; ++i) {
+        if (--first_len > 0 || d->pieces[i] == d->pieces[i - 1])
+            d->group_len[n]++;
+        else
+            d->group_len[++n] = 1;
+    }
+    d->group_len[++n] = 0;
+
+    const bool pp = e.has_pawns && e.pawn_count[1];
+    int next = pp ? 2 : 1;
+    int free_squares = 64 - d->group_len[0] - (pp ? d->group_len[1] : 0);
+    uint64_t idx = 1;
+
+    for (int k = 0; next < n || k == order[0] || k == order[1]; ++k) {
+        if (k == order[0]) {
+            d->group_idx[0] = idx;
+            idx *= e.has_pawns ? LEAD_PAWNS_SIZE[d->group_len[0]][f]
+                : e.has_unique_pieces ? 31332 : 462;
+        } else if (k == order[1]) {
+            d->group_idx[1] = idx;
+            idx *= BINOMIAL[d->group_len[1]][48 - d->group_len[0]];
+        } else {
+            d->group_idx[next] = idx;
+            idx *= BINOMIAL[d->group_len[next]][free_squares];
+            free_squares -= d->group_len[next++];
+        }
+    }
+    d->group_idx[n] = idx;
+}
+
+uint8_t set_sym_len(PairsData *d, const uint16_t s, std::vector<bool> &visited) {
+    visited[s] = true;
+
+    const uint16_t sr = right_sym(d->btree, s);
+    if (sr == 0xFFF)
+        return 0;
+
+    const uint16_t sl = left_sym(d->btree, s);
+    if (!visited[sl])
+        d->sym_len[sl] = set_sym_len(d, sl, visited);
+    if (!visited[sr])
+        d->sym_len[sr] = set_sym_len(d, sr, visited);
+
+    return static_cast<uint8_t>(d->sym_len[sl] + d->sym_len[sr] + 1);
+}
+
+const uint8_t *set_sizes(PairsData *d, const uint8_t *data) {
+    d->flags = *data++;
+    if (d->flags & TB_SINGLE_VALUE) {
+        d->num_blocks = 0;
+        d->span = d->sparse_index_size = 0;
+        d->min_sym_len = *data++;
+        return data;
+    }
+
+    //the index past the last group is the size of the table
+    const uint64_t tb_size = d->group_idx[std::find(d->group_len,
+        d->group_len + TB_PIECES, 0) - d->group_len];
+
+    d->block_size = static_cast<size_t>(1) << *data++;
+    d->span = static_cast<size_t>(1) << *data++;
+    d->sparse_index_size = static_cast<size_t>(
+        (tb_size + d->span - 1) / d->span);
+    const uint8_t padding = *data++;
+    d->num_blocks = read_le<uint32_t>(data);
+    data += sizeof(uint32_t);
+    d->block_length_size = d->num_blocks + padding;
+    d->max_sym_len = *data++;
+    d->min_sym_len = *data++;
+    d->lowest_sym = data;
+
+    //canonical Huffman code: base64[i] is the first code of length
+    //min_sym_len + i, left aligned in 64 bits
+    d->base64.assign(d->max_sym_len - d->min_sym_len + 1, 0);
+    for (int i = static_cast<int>(d->base64.size()) - 2; i >= 0; --i) {
+        d->base64[i] = (d->base64[i + 1]
+            + read_le<uint16_t>(d->lowest_sym + 2 * i)
+            - read_le<uint16_t>(d->lowest_sym + 2 * (i + 1))) / 2;
+    }
+    for (size_t i = 0; i < d->base64.size(); ++i)
+        d->base64[i] <<= 64 - i - d->min_sym_len;
+    data += d->base64.size() * sizeof(uint16_t);
+
+    d->sym_len.assign(read_le<uint16_t>(data), 0);
+    data += sizeof(uint16_t);
+    d->btree = data;
+
+    std::vector<bool> visited(d->sym_len.size());
+    for (size_t s = 0; s < d->sym_len.size(); ++s) {
+        if (!visited[s])
+            d->sym_len[s] = set_sym_len(d, static_cast<uint16_t>(s), visited);
+    }
+
+    return data + d->sym_len.size() * 3 + (d->sym_len.size() & 1);
+}
+
+const uint8_t *set_dtz_map(Entry &e, const uint8_t *data, const File max_file) {
+    const uint8_t *map = e.tables[DTZ].map = data;
+
+    for (File f = FILE_A; f <= max_file; ++f) {
+        PairsData *d = e.get(DTZ, 0, f);
+        if (!(d->flags & TB_MAPPED))
+            continue;
+
+        if (d->flags & TB_WIDE) {
+            data += reinterpret_cast<uintptr_t>(data) & 1;
+            for (uint16_t &idx: d->map_idx) {
+                idx = static_cast<uint16_t>((data - map) / 2 + 1);
+                data += 2 * read_le<uint16_t>(data) + 2;
+            }
+        } else {
+            for (uint16_t &idx: d->map_idx) {
+                idx = static_cast<uint16_t>(data - map + 1);
+                data += *data + 1;
+            }
+        }
+    }
+
+    return data + (reinterpret_cast<uintptr_t>(data) & 1);
+}
+
+void init_table(Entry &e, const TBType type, const uint8_t *data) {
+    //first byte: bit 0 split (both sides stored), bit 1 has pawns
+    data++;
+
+    const int sides = type == WDL && e.key != e.key2 ? 2 : 1;
+    const File max_file = e.has_pawns ? FILE_D : FILE_A;
+    const bool pp = e.has_pawns && e.pawn_count[1];
+
+    for (File f = FILE_A; f <= max_file; ++f) {
+        for (int i = 0; i < sides; ++i)
+            *e.get(type, i, f) = PairsData();
+
+        const int order[2][2] = {
+            { *data & 0xF, pp ? *(data + 1) & 0xF : 0xF },
+            { *data >> 4, pp ? *(data + 1) >> 4 : 0xF },
+        };
+        data += 1 + pp;
+
+        for (int k = 0; k < e.piece_count; ++k, ++data) {
+            for (int i = 0; i < sides; ++i)
+                e.get(type, i, f)->pieces[k] = static_cast<Piece>(
+                    i ? *data >> 4 : *data & 0xF);
+        }
+
+        for (int i = 0; i < sides; ++i)
+            set_groups(e, e.get(type, i, f), order[i], f);
+    }
+
+    data += reinterpret_cast<uintptr_t>(data) & 1;
+
+    for (File f = FILE_A; f <= max_file; ++f)
+        for (int i = 0; i < sides; ++i)
+            data = set_sizes(e.get(type, i, f), data);
+
+    if (type == DTZ)
+        data = set_dtz_map(e, data, max_file);
+
+    for (File f = FILE_A; f <= max_file; ++f) {
+        for (int i = 0; i < sides; ++i) {
+            PairsData *d = e.get(type, i, f);
+            d->sparse_index = data;
+            data += d->sparse_index_size * 6;
+        }
+    }
+
+    for (File f = FILE_A; f <= max_file; ++f) {
+        for (int i = 0; i < sides; ++i) {
+            PairsData *d = e.get(type, i, f);
+            d->block_length = data;
+            data += d->block_length_size * sizeof(uint16_t);
+        }
+    }
+
+    for (File f = FILE_A; f <= max_file; ++f) {
+        for (int i = 0; i < sides; ++i) {
+            data = reinterpret_cast<const uint8_t*>(
+                (reinterpret_cast<uintptr_t>(data) + 0x3F) & ~uintptr_t(0x3F));
+            PairsData *d = e.get(type, i, f);
+            d->data = data;
+            data += static_cast<uint64_t>(d->num_blocks) * d->block_size;
+        }
+    }
+}
+
+bool mapped(Entry &e, const TBType type) {
+    Table &t = e.tables[type];
+    if (t.ready.load(std::memory_order_acquire))
+        return t.base != nullptr;
+
+    std::lock_guard<std::mutex> lock(MAP_MUTEX);
+    if (t.ready.load(std::memory_order_relaxed))
+        return t.base != nullptr;
+
+    const std::string name = e.name + (type == WDL ? ".rtbw" : ".rtbz");
+    if (const uint8_t *data = map_file(name, type, t.base, t.mapping))
+        init_table(e, type, data);
+
+    t.ready.store(true, std::memory_order_release);
+    return t.base != nullptr;
+}
+
+int decompress_pairs(const PairsData *d, const uint64_t idx) {
+    if (d->flags & TB_SINGLE_VALUE)
+        return d->min_sym_len;
+
+    //the sparse index points near the value, walk the blocks from there
+    const auto k = static_cast<uint32_t>(idx / d->span);
+    uint32_t block = read_le<uint32_t>(d->sparse_index + 6 * k);
+    int offset = read_le<uint16_t>(d->sparse_index + 6 * k + 4)
+        + static_cast<int>(idx % d->span) - static_cast<int>(d->span / 2);
+
+    while (offset < 0)
+        offset += read_le<uint16_t>(d->block_length + 2 * --block) + 1;
+    while (offset > read_le<uint16_t>(d->block_length + 2 * block))
+        offset -= read_le<uint16_t>(d->block_length + 2 * block++) + 1;
+
+    const uint8_t *ptr = d->data + static_cast<uint64_t>(block) * d->block_size;
+    uint64_t buf64 = read_be<uint64_t>(ptr);
+    ptr += sizeof(uint64_t);
+    int buf64_size = 64;
+    uint16_t sym;
+
+    //skip whole symbols until the one covering the offset
+    while (true) {
+        int len = 0;
+        while (buf64 < d->base64[len])
+            ++len;
+
+        sym = static_cast<uint16_t>((buf64 - d->base64[len])
+            >> (64 - len - d->min_sym_len));
+        sym = static_cast<uint16_t>(sym + read_le<uint16_t>(d->lowest_sym + 2 * len));
+
+        if (offset < d->sym_len[sym] + 1)
+            break;
+        offset -= d->sym_len[sym] + 1;
+
+        len += d->min_sym_len;
+        buf64 <<= len;
+        buf64_size -= len;
+        if (buf64_size <= 32) {
+            buf64_size += 32;
+            buf64 |= static_cast<uint64_t>(read_be<uint32_t>(ptr))
+                << (64 - buf64_size);
+            ptr += sizeof(uint32_t);
+        }
+    }
+
+    //then expand the pairs down to a single value
+    while (d->sym_len[sym]) {
+        const uint16_t left = left_sym(d->btree, sym);
+        if (offset < d->sym_len[left] + 1) {
+            sym = left;
+        } else {
+            offset -= d->sym_len[left] + 1;
+            sym = right_sym(d->btree, sym);
+        }
+    }
+
+    return left_sym(d->btree, sym);
+}
+
+int map_score(Entry &e, const TBType type, const File f,
+        int value, const WDLScore wdl)
+{
+    if (type == WDL)
+        return value - 2;
+
+    constexpr int WDL_MAP[] = { 1, 3, 0, 2, 0 };
+    const PairsData *d = e.get(DTZ, 0, f);
+    if (d->flags & TB_MAPPED) {
+        const uint8_t *map = e.tables[DTZ].map;
+        const int i = d->map_idx[WDL_MAP[wdl + 2]] + value;
+        value = d->flags & TB_WIDE ? read_le<uint16_t>(map + 2 * i) : map[i];
+    }
+
+    //convert moves to plies
+    if ((wdl == WDL_WIN && !(d->flags & TB_WIN_PLIES))
+            || (wdl == WDL_LOSS && !(d->flags & TB_LOSS_PLIES))
+            || wdl == WDL_CURSED_WIN || wdl == WDL_BLESSED_LOSS)
+        value *= 2;
+
+    return value + 1;
+}
+
+int probe_table(const Board &b, const TBType type,
+        ProbeState &state, const WDLScore wdl = WDL_DRAW)
+{
+    if (popcnt(b.pieces()) == 2)
+        return WDL_DRAW;
+
+    const auto it = BY_KEY.find(b.mat_key());
+    if (it == BY_KEY.end() || !mapped(*it->second, type)) {
+        state = PROBE_FAIL;
+        return 0;
+    }
+    Entry &e = *it->second;
+
+    /*
+     * Tables are stored with the stronger side as white, and only for
+     * white to move if both sides have the same pieces. Otherwise the
+     * colors are swapped and the board is flipped vertically.
+     * */
+    const bool symmetric_btm = e.key == e.key2 && b.side_to_move() == BLACK;
+    const bool black_stronger = b.mat_key() != e.key;
+    const bool flip = symmetric_btm || black_stronger;
+    const int flip_color = flip * 8, flip_squares = flip * 56;
+    const int stm = flip ^ b.side_to_move();
+
+    Square squares[TB_PIECES];
+    Piece pieces[TB_PIECES];
+    int size = 0, lead_pawns_cnt = 0;
+    Bitboard lead_pawns = 0;
+    File tb_file = FILE_A;
+
+    //pawn tables are split by the file of the leading pawn
+    if (e.has_pawns) {
+        const auto pc = static_cast<Piece>(
+            e.get(type, 0, 0)->pieces[0] ^ flip_color);
+        Bitboard bb = lead_pawns = b.pieces(color_of(pc), PAWN);
+        while (bb)
+            squares[size++] = static_cast<Square>(pop_lsb(bb) ^ flip_squares);
+        lead_pawns_cnt = size;
+
+        std::swap(squares[0], *std::max_element(squares,
+                    squares + lead_pawns_cnt, pawns_comp));
+        const File f = file_of(squares[0]);
+        tb_file = std::min(f, static_cast<File>(FILE_H - f));
+    }
+
+    //DTZ tables store one side to move only
+    if (type == DTZ) {
+        const uint8_t flags = e.get(DTZ, stm, tb_file)->flags;
+        if ((flags & TB_STM) != stm && (e.key != e.key2 || e.has_pawns)) {
+            state = PROBE_CHANGE_STM;
+            return 0;
+        }
+    }
+
+    Bitboard bb = b.pieces() ^ lead_pawns;
+    while (bb) {
+        const Square s = pop_lsb(bb);
+        squares[size] = static_cast<Square>(s ^ flip_squares);
+        pieces[size++] = static_cast<Piece>(b.piece_on(s) ^ flip_color);
+    }
+
+    //reorder the pieces as the table expects them
+    PairsData *d = e.get(type, stm, tb_file);
+    for (int i = lead_pawns_cnt; i < size - 1; ++i) {
+        for (int j = i + 1; j < size; ++j) {
+            if (d->pieces[i] == pieces[j]) {
+                std::swap(pieces[i], pieces[j]);
+                std::swap(squares[i], squares[j]);
+                break;
+            }
+        }
+    }
+
+    //the leading piece goes to the a-d files...
+    if (file_of(squares[0]) > FILE_D) {
+        for (int i = 0; i < size; ++i)
+            squares[i] = flip_file(squares[i]);
+    }
+
+    uint64_t idx;
+    if (e.has_pawns) {
+        idx = LEAD_PAWN_IDX[lead_pawns_cnt][squares[0]];
+        std::stable_sort(squares + 1, squares + lead_pawns_cnt, pawns_comp);
+        for (int i = 1; i < lead_pawns_cnt; ++i)
+            idx += BINOMIAL[i][MAP_PAWNS[squares[i]]];
+    } else {
+        //...and without pawns also below the 5th rank
+        //and below the a1-h8 diagonal
+        if (rank_of(squares[0]) > RANK_4) {
+            for (int i = 0; i < size; ++i)
+                squares[i] = flip_rank(squares[i]);
+        }
+
+        for (int i = 0; i < d->group_len[0]; ++i) {
+            if (!off_a1h8(squares[i]))
+                continue;
+            if (off_a1h8(squares[i]) > 0) {
+                for (int j = i; j < size; ++j)
+                    squares[j] = static_cast<Square>(
+                        ((squares[j] >> 3) | (squares[j] << 3)) & 63);
+            }
+            break;
+        }
+
+        if (e.has_unique_pieces) {
+            //three unique pieces are encoded together, 31332 ways
+            const int adjust1 = squares[1] > squares[0];
+            const int adjust2 = (squares[2] > squares[0])
+                + (squares[2] > squares[1]);
+
+            if (off_a1h8(squares[0])) {
+                idx = (MAP_A1D1D4[squares[0]] * 63
+                    + (squares[1] - adjust1)) * 62
+                    + squares[2] - adjust2;
+            } else if (off_a1h8(squares[1])) {
+                idx = (6 * 63 + rank_of(squares[0]) * 28
+                    + MAP_B1H1H7[squares[1]]) * 62
+                    + squares[2] - adjust2;
+            } else if (off_a1h8(squares[2])) {
+                idx = 6 * 63 * 62 + 4 * 28 * 62
+                    + rank_of(squares[0]) * 7 * 28
+                    + (rank_of(squares[1]) - adjust1) * 28
+                    + MAP_B1H1H7[squares[2]];
+            } else {
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28
+                    + rank_of(squares[0]) * 7 * 6
+                    + (rank_of(squares[1]) - adjust1) * 6
+                    + (rank_of(squares[2]) - adjust2);
+            }
+        } else {
+            idx = MAP_KK[MAP_A1D1D4[squares[0]]][squares[1]];
+        }
+    }
+
+    //the other groups are combinations of the squares left
+    idx *= d->group_idx[0];
+    Square *group_sq = squares + d->group_len[0];
+    bool remaining_pawns = e.has_pawns && e.pawn_count[1];
+    for (int next = 1; d->group_len[next]; ++next) {
+        std::stable_sort(group_sq, group_sq + d->group_len[next]);
+        uint64_t n = 0;
+        for (int i = 0; i < d->group_len[next]; ++i) {
+            const auto adjust = std::count_if(squares, group_sq,
+                [s = group_sq[i]](const Square x) { return s > x; });
+            n += BINOMIAL[i + 1][group_sq[i] - adjust - 8 * remaining_pawns];
+        }
+        remaining_pawns = false;
+        idx += n * d->group_idx[next];
+        group_sq += d->group_len[next];
+    }
+
+    return map_score(e, type, tb_file, decompress_pairs(d, idx), wdl);
+}
+
+bool is_capture(const Board &b, const Move m) {
+    return type_of(m) == EN_PASSANT || (type_of(m) != CASTLING
+        && b.piece_on(to_sq(m)) != NO_PIECE);
+}
+
+bool is_zeroing(const Board &b, const Move m) {
+    return is_capture(b, m) || type_of(b.piece_on(from_sq(m))) == PAWN;
+}
+
+/*
+ * Tables know nothing about en passant and store "don't care" values
+ * where a capture is best, so captures (and pawn moves for DTZ) are
+ * searched first and the table only decides the rest.
+ * */
+template<bool check_zeroing>
+WDLScore search(const Board &b, ProbeState &state) {
+    ExtMove moves[MAX_MOVES];
+    const ExtMove *end = generate<LEGAL>(b, moves);
+    const auto total = end - moves;
+    WDLScore best = WDL_LOSS;
+    int count = 0;
+
+    for (const ExtMove *it = moves; it != end; ++it) {
+        if (check_zeroing ? !is_zeroing(b, *it) : !is_capture(b, *it))
+            continue;
+
+        ++count;
+        const auto v = static_cast<WDLScore>(
+            -search<false>(b.do_move(*it), state));
+        if (state == PROBE_FAIL)
+            return WDL_DRAW;
+
+        if (v > best) {
+            best = v;
+            if (v >= WDL_WIN) {
+                state = PROBE_ZEROING;
+                return v;
+            }
+        }
+    }
+
+    const bool no_more_moves = count && count == total;
+    WDLScore v = best;
+    if (!no_more_moves) {
+        v = static_cast<WDLScore>(probe_table(b, WDL, state));
+        if (state == PROBE_FAIL)
+            return WDL_DRAW;
+    }
+
+    if (best >= v) {
+        state = best > WDL_DRAW || no_more_moves ? PROBE_ZEROING : PROBE_OK;
+        return best;
+    }
+
+    state = PROBE_OK;
+    return v;
+}
+
+//DTZ of the move before a zeroing one
+int dtz_before_zeroing(const WDLScore wdl) {
+    switch (wdl) {
+    case WDL_WIN: return 1;
+    case WDL_CURSED_WIN: return 101;
+    case WDL_BLESSED_LOSS: return -101;
+    case WDL_LOSS: return -1;
+    default: return 0;
+    }
+}
+
+} //namespace
+
+int init(const std::string &paths) {
+    static bool indices_ready = false;
+    if (!indices_ready) {
+        init_indices();
+        indices_ready = true;
+    }
+
+    for (const Entry &e: ENTRIES) {
+        unmap(e.tables[WDL]);
+        unmap(e.tables[DTZ]);
+    }
+    ENTRIES.clear();
+    BY_KEY.clear();
+    PATHS.clear();
+    MAX_PIECES = 0;
+
+    if (paths.empty() || paths == "<empty>")
+        return 0;
+
+#ifdef _WIN32
+    constexpr char SEP = ';';
+#else
+    constexpr char SEP = ':';
+#endif
+    for (size_t start = 0, end; start <= paths.size(); start = end + 1) {
+        end = std::min(paths.find(SEP, start), paths.size());
+        if (end > start)
+            PATHS.push_back(paths.substr(start, end - start));
+    }
+
+    add_all();
+    return static_cast<int>(ENTRIES.size());
+}
+
+int max_pieces() {
+    return MAX_PIECES;
+}
+
+WDLScore probe_wdl(const Board &b, ProbeState &state) {
+    state = PROBE_OK;
+    return search<false>(b, state);
+}
+
+/*
+ * Plies to the next zeroing move with optimal play, signed by the
+ * outcome: 1 for a winning capture or pawn move, 101+ for cursed wins.
+ * 0 is a draw or a failed probe.
+ * */
+int probe_dtz(const Board &b, ProbeState &state) {
+    state = PROBE_OK;
+    const WDLScore wdl = search<true>(b, state);
+    if (state == PROBE_FAIL || wdl == WDL_DRAW)
+        return 0;
+
+    if (state == PROBE_ZEROING)
+        return dtz_before_zeroing(wdl);
+
+    int dtz = probe_table(b, DTZ, state, wdl);
+    if (state == PROBE_FAIL)
+        return 0;
+
+    if (state != PROBE_CHANGE_STM) {
+        const bool rule50 = wdl == WDL_BLESSED_LOSS || wdl == WDL_CURSED_WIN;
+        return (dtz + 100 * rule50) * sign_of(wdl);
+    }
+
+    //the table stores the other side to move, search one ply
+    ExtMove moves[MAX_MOVES];
+    const ExtMove *end = generate<LEGAL>(b, moves);
+    int min_dtz = 0xFFFF;
+    for (const ExtMove *it = moves; it != end; ++it) {
+        const bool zeroing = is_zeroing(b, *it);
+        const Board bb = b.do_move(*it);
+
+        dtz = zeroing ? -dtz_before_zeroing(search<false>(bb, state))
+            : -probe_dtz(bb, state);
+
+        if (dtz == 1 && bb.checkers() && !has_legal_move(bb))
+            min_dtz = 1;
+
+        if (!zeroing)
+            dtz += sign_of(dtz);
+
+        if (dtz < min_dtz && sign_of(dtz) == sign_of(wdl))
+            min_dtz = dtz;
+
+        if (state == PROBE_FAIL)
+            return 0;
+    }
+
+    //no legal moves, we are mated
+    return min_dtz == 0xFFFF ? -1 : min_dtz;
+}
+
+bool rank_root_moves(const Board &root, Stack &st, RankedMove *moves, const int n) {
+    const int cnt50 = root.half_moves();
+    //after a repetition the opponent can repeat again, so no win is safe
+    //from the 50-move rule
+    const bool rep = st.has_repeated(root);
+    ProbeState state = PROBE_OK;
+
+    st.push(root.key());
+    for (int i = 0; i < n && state != PROBE_FAIL; ++i) {
+        const Board bb = root.do_move(moves[i].move);
+
+        int dtz;
+        if (!bb.half_moves()) {
+            dtz = dtz_before_zeroing(
+                static_cast<WDLScore>(-probe_wdl(bb, state)));
+        } else if (st.is_repetition(bb)) {
+            dtz = 0;
+        } else {
+            dtz = -probe_dtz(bb, state);
+            dtz += sign_of(dtz);
+        }
+
+        if (dtz == 2 && bb.checkers() && !has_legal_move(bb))
+            dtz = 1;
+
+        //wins inside the 50-move budget are equal, the rest are
+        //ranked by how close the 50-move draw comes
+        moves[i].dtz = dtz;
+        moves[i].rank = dtz > 0
+            ? (dtz + cnt50 <= 99 && !rep ? 1000 : 1000 - (dtz + cnt50))
+            : dtz < 0
+            ? (-dtz * 2 + cnt50 < 100 ? -1000 : -1000 + (-dtz + cnt50))
+            : 0;
+    }
+    st.pop();
+
+    return state != PROBE_FAIL;
+}
+
+} //namespace syzygy
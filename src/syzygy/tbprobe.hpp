@@ -0,0 +1,68 @@
+#ifndef SYZYGY_TBPROBE_HPP
+#define SYZYGY_TBPROBE_HPP
+
+#include "../primitives/common.hpp"
+#include <string>
+
+class Board;
+class Stack;
+
+/*
+ * Syzygy tablebase probing. The files are mmapped on first use.
+ * WDL tables are exact only right after a zeroing move, so the search
+ * probes them when half_moves() == 0; DTZ tables are probed at the root.
+ * None of them know about castling, so positions must not have rights.
+ * The search uses them only in TB_SEARCH builds: the decoder is checked
+ * by tbcheck on the hand-built KQvK file, not yet on the real tables.
+ * */
+namespace syzygy {
+
+enum WDLScore : int {
+    WDL_LOSS = -2,
+    WDL_BLESSED_LOSS = -1, //loss, but a draw by the 50-move rule
+    WDL_DRAW = 0,
+    WDL_CURSED_WIN = 1,    //win, but a draw by the 50-move rule
+    WDL_WIN = 2,
+};
+
+enum ProbeState : int {
+    PROBE_CHANGE_STM = -1, //DTZ table stores the other side to move
+    PROBE_FAIL = 0,
+    PROBE_OK = 1,
+    PROBE_ZEROING = 2,     //the best move zeroes the 50-move counter
+};
+
+struct RankedMove {
+    Move move;
+    int dtz;  //plies to a zeroing move, from the root
+    int rank; //1000 for a win, 0 for a draw, -1000 for a loss
+};
+
+//paths are separated by ':' (';' on Windows), "" or "<empty>" unloads.
+//Returns the number of tables found
+int init(const std::string &paths);
+
+//most pieces on the board, kings included, a table exists for
+[[nodiscard]] int max_pieces();
+
+WDLScore probe_wdl(const Board &b, ProbeState &state);
+int probe_dtz(const Board &b, ProbeState &state);
+
+//Fills dtz and rank of every root move, st holds the positions before
+//the root (left as it was). A move into a repetition is a draw, and after
+//a repetition wins get no 50-move budget. False if any probe failed
+bool rank_root_moves(const Board &root, Stack &st, RankedMove *moves, int n);
+
+struct CheckResult {
+    int tables{};
+    uint64_t positions{}, mismatches{};
+    std::string first_mismatch;
+};
+
+//Compares every position of the loaded KQvK, KRvK, KBvK and KNvK tables
+//with a retrograde solution, see tbcheck.cpp
+CheckResult check_tables();
+
+} //namespace syzygy
+
+#endif
@@ -0,0 +1,487 @@
+#include "train.hpp"
+#include "board/board.hpp"
+#include "board/packed.hpp"
+#include "core/search_common.hpp"
+#include "primitives/mapped_file.hpp"
+#include "primitives/parallel.hpp"
+#include "cli.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <vector>
+
+/*
+ * FILE: train.cpp
+ * The float network mirrors the integer one of nnue/nnue.cpp:
+ *     feature transformer, 41024 HalfKP inputs -> 256 per side,
+ *         clamped to [0, 1] (int16 weights, 127 = 1.0)
+ *     512 -> 32 -> 32, clamped to [0, 1] (int8 weights, 64 = 1.0,
+ *         int32 biases, 127 * 64 = 1.0, the engine shifts sums by 6)
+ *     32 -> 1, one unit being EVAL_SCALE centipawns (the engine
+ *         divides the output by 16)
+ * so rounding the weights is the whole export, but for HIDDEN_ROUND:
+ * without it every hidden unit comes out half a step low, which adds up
+ * to 15-20 cp. Hidden weights are kept inside what int8 holds.
+ *
+ * A batch is split between the threads twice: by positions for the
+ * forward and backward pass (each thread sums its own gradients of the
+ * small layers and keeps the gradient of every accumulator), then by
+ * accumulator columns to add those into the transformer gradient,
+ * so no two threads write the same float. Only the transformer rows
+ * of features seen in the batch get an Adam step. The inner loops run
+ * over contiguous floats and are left to the compiler to vectorize.
+ * */
+
+namespace {
+
+constexpr int INPUTS = 64 * 641, HALF = 256, L1 = 2 * HALF, L2 = 32, L3 = 32;
+constexpr int MAX_FEATURES = 30; //pieces but the kings
+
+constexpr float EVAL_SCALE = 600, SIGMOID_SCALE = 400;
+constexpr float FT_Q = 127, HIDDEN_Q = 64, OUT_Q = EVAL_SCALE * 16 / 127;
+constexpr float HIDDEN_MAX = 127 / HIDDEN_Q, OUT_MAX = 127 / OUT_Q;
+//the engine's shift rounds down, half a step more in the bias rounds
+constexpr int32_t HIDDEN_ROUND = 32;
+
+constexpr float BETA1 = 0.9f, BETA2 = 0.999f, EPSILON = 1e-8f;
+
+//the file header, see verify_net() in nnue/nnue.cpp
+constexpr uint32_t VERSION = 0x7AF32F16u, NET_HASH = 0x3e5aa6eeU;
+constexpr uint32_t FT_HASH = 0x5d69d7b8, NETWORK_HASH = 0x63337156;
+constexpr size_t DESCRIPTION_SIZE = 177, FILE_SIZE = 21022697;
+
+struct Layer {
+    std::vector<float> w, b;
+    std::vector<float> mw, vw, mb, vb;
+
+    Layer(const size_t inputs, const size_t outputs)
+        : w(inputs * outputs), b(outputs), mw(w.size()), vw(w.size()),
+          mb(b.size()), vb(b.size()) {}
+};
+
+struct Network {
+    Layer ft{INPUTS, HALF}, l1{L1, L2}, l2{L2, L3}, out{L3, 1};
+};
+
+//gradients of everything but the transformer weights
+struct Gradients {
+    std::vector<float> ft_b, l1_w, l1_b, l2_w, l2_b, out_w, out_b;
+
+    Gradients() : ft_b(HALF), l1_w(L1 * L2), l1_b(L2), l2_w(L2 * L3),
+        l2_b(L3), out_w(L3), out_b(1) {}
+
+    void clear() {
+        for (auto *v: { &ft_b, &l1_w, &l1_b, &l2_w, &l2_b, &out_w, &out_b })
+            std::fill(v->begin(), v->end(), 0.0f);
+    }
+};
+
+struct Sample {
+    uint16_t features[2][MAX_FEATURES]; //side to move first
+    int n;
+    float target;
+};
+
+//Board to HalfKP indices, as make_index() in nnue/nnue.cpp
+bool make_sample(const Board &b, const PackedBoard &pb, const float lambda, Sample &s) {
+    const Color persp[2] = { b.side_to_move(), ~b.side_to_move() };
+    s.n = 0;
+    Bitboard pieces = b.pieces() & ~b.pieces(KING);
+    while (pieces) {
+        if (s.n == MAX_FEATURES)
+            return false;
+        const Square sq = pop_lsb(pieces);
+        const Piece p = b.piece_on(sq);
+        for (int i = 0; i < 2; ++i) {
+            const int flip = persp[i] == WHITE ? 0 : 63;
+            const int ksq = b.king_square(persp[i]) ^ flip;
+            const int kind = 2 * (type_of(p) - PAWN) + (color_of(p) != persp[i]);
+            s.features[i][s.n] = static_cast<uint16_t>((sq ^ flip) + 1 + 64 * kind + 641 * ksq);
+        }
+        ++s.n;
+    }
+    const float score = 1 / (1 + std::exp(-pb.score / SIGMOID_SCALE));
+    s.target = lambda * score + (1 - lambda) * (pb.result + 1) / 2.0f;
+    return true;
+}
+
+class Trainer {
+public:
+    Trainer(const PackedReader &data, const TrainConfig &cfg);
+
+    void randomize(uint64_t seed);
+    bool load(const std::string &path);
+    bool save(const std::string &path) const;
+
+    //one pass over the data in random order, returns the mean loss
+    double epoch(std::mt19937_64 &rng);
+
+private:
+    double batch(const uint32_t *order, size_t n);
+    double backprop(const Sample &s, Gradients &g, float *dacc) const;
+    void adam(Layer &l, const std::vector<float> &gw, const std::vector<float> &gb, float clip);
+
+    const PackedReader &data_;
+    const TrainConfig &cfg_;
+    const int threads_;
+    Network net_;
+
+    std::vector<Sample> samples_;
+    std::vector<float> dacc_; //per sample and side
+    std::vector<Gradients> grads_;
+    std::vector<float> ft_grad_;
+    std::vector<uint8_t> touched_;
+    std::vector<uint32_t> rows_;
+    int step_{};
+};
+
+Trainer::Trainer(const PackedReader &data, const TrainConfig &cfg)
+    : data_(data), cfg_(cfg), threads_(std::max(cfg.threads, 1)),
+      samples_(cfg.batch), dacc_(static_cast<size_t>(cfg.batch) * L1), grads_(threads_),
+      ft_grad_(static_cast<size_t>(INPUTS) * HALF), touched_(INPUTS) {}
+
+void Trainer::randomize(const uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    auto fill = [&rng](std::vector<float> &v, const float range) {
+        std::uniform_real_distribution<float> dist(-range, range);
+        for (auto &x: v)
+            x = dist(rng);
+    };
+    //about 30 features make an accumulator
+    fill(net_.ft.w, 0.1f);
+    std::fill(net_.ft.b.begin(), net_.ft.b.end(), 0.25f);
+    fill(net_.l1.w, 1 / std::sqrt(static_cast<float>(L1)));
+    fill(net_.l2.w, 1 / std::sqrt(static_cast<float>(L2)));
+    fill(net_.out.w, 1 / std::sqrt(static_cast<float>(L3)));
+}
+
+double Trainer::backprop(const Sample &s, Gradients &g, float *dacc) const {
+    const Network &n = net_;
+    float acc[L1], a[L1], z1[L2], h1[L2], z2[L3], h2[L3];
+
+    for (int p = 0; p < 2; ++p) {
+        float *sum = acc + p * HALF;
+        std::copy(n.ft.b.begin(), n.ft.b.end(), sum);
+        for (int k = 0; k < s.n; ++k) {
+            const float *w = &n.ft.w[static_cast<size_t>(s.features[p][k]) * HALF];
+            for (int i = 0; i < HALF; ++i)
+                sum[i] += w[i];
+        }
+    }
+    for (int i = 0; i < L1; ++i)
+        a[i] = std::clamp(acc[i], 0.0f, 1.0f);
+
+    for (int o = 0; o < L2; ++o) {
+        const float *w = &n.l1.w[o * L1];
+        float sum = n.l1.b[o];
+        for (int i = 0; i < L1; ++i)
+            sum += w[i] * a[i];
+        z1[o] = sum;
+        h1[o] = std::clamp(sum, 0.0f, 1.0f);
+    }
+    for (int o = 0; o < L3; ++o) {
+        const float *w = &n.l2.w[o * L2];
+        float sum = n.l2.b[o];
+        for (int i = 0; i < L2; ++i)
+            sum += w[i] * h1[i];
+        z2[o] = sum;
+        h2[o] = std::clamp(sum, 0.0f, 1.0f);
+    }
+    float y = n.out.b[0];
+    for (int i = 0; i < L3; ++i)
+        y += n.out.w[i] * h2[i];
+
+    const float k = EVAL_SCALE / SIGMOID_SCALE;
+    const float pred = 1 / (1 + std::exp(-k * y));
+    const float error = pred - s.target;
+    const float dy = 2 * error * pred * (1 - pred) * k;
+
+    //backwards, a clamped unit passes gradients only inside (0, 1)
+    float dz2[L3], dz1[L2]{}, da[L1]{};
+    g.out_b[0] += dy;
+    for (int i = 0; i < L3; ++i) {
+        g.out_w[i] += dy * h2[i];
+        dz2[i] = z2[i] > 0 && z2[i] < 1 ? dy * n.out.w[i] : 0;
+    }
+    for (int o = 0; o < L3; ++o) {
+        if (dz2[o] == 0)
+            continue;
+        const float *w = &n.l2.w[o * L2];
+        float *gw = &g.l2_w[o * L2];
+        g.l2_b[o] += dz2[o];
+        for (int i = 0; i < L2; ++i) {
+            gw[i] += dz2[o] * h1[i];
+            dz1[i] += dz2[o] * w[i];
+        }
+    }
+    for (int o = 0; o < L2; ++o) {
+        dz1[o] = z1[o] > 0 && z1[o] < 1 ? dz1[o] : 0;
+        if (dz1[o] == 0)
+            continue;
+        const float *w = &n.l1.w[o * L1];
+        float *gw = &g.l1_w[o * L1];
+        g.l1_b[o] += dz1[o];
+        for (int i = 0; i < L1; ++i) {
+            gw[i] += dz1[o] * a[i];
+            da[i] += dz1[o] * w[i];
+        }
+    }
+    for (int i = 0; i < L1; ++i) {
+        dacc[i] = acc[i] > 0 && acc[i] < 1 ? da[i] : 0;
+        g.ft_b[i % HALF] += dacc[i];
+    }
+    return error * error;
+}
+
+void Trainer::adam(Layer &l, const std::vector<float> &gw, const std::vector<float> &gb,
+        const float clip)
+{
+    const float c1 = 1 - std::pow(BETA1, static_cast<float>(step_));
+    const float c2 = 1 - std::pow(BETA2, static_cast<float>(step_));
+    const float rate = static_cast<float>(cfg_.rate);
+    auto update = [=](float *w, const float *g, float *m, float *v, const size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            m[i] = BETA1 * m[i] + (1 - BETA1) * g[i];
+            v[i] = BETA2 * v[i] + (1 - BETA2) * g[i] * g[i];
+            w[i] = std::clamp(w[i] - rate * (m[i] / c1) / (std::sqrt(v[i] / c2) + EPSILON),
+                -clip, clip);
+        }
+    };
+    if (!gw.empty())
+        update(l.w.data(), gw.data(), l.mw.data(), l.vw.data(), l.w.size());
+    update(l.b.data(), gb.data(), l.mb.data(), l.vb.data(), l.b.size());
+}
+
+double Trainer::batch(const uint32_t *order, const size_t n) {
+    //forward and backward, split by positions
+    std::vector<double> losses(threads_);
+    parallel_for(threads_, n, [&](const int t, const size_t first, const size_t last) {
+        Gradients &g = grads_[t];
+        g.clear();
+        Board b;
+        for (size_t i = first; i < last; ++i) {
+            const PackedBoard &pb = data_[order[i]];
+            Sample &s = samples_[i];
+            if (!b.load_packed(pb) || !make_sample(b, pb, static_cast<float>(cfg_.lambda), s)) {
+                s.n = 0;
+                std::fill_n(&dacc_[i * L1], L1, 0.0f);
+                continue;
+            }
+            losses[t] += backprop(s, g, &dacc_[i * L1]);
+        }
+    });
+
+    rows_.clear();
+    for (size_t i = 0; i < n; ++i) {
+        for (int p = 0; p < 2; ++p) {
+            for (int k = 0; k < samples_[i].n; ++k) {
+                const uint16_t f = samples_[i].features[p][k];
+                if (!touched_[f]) {
+                    touched_[f] = 1;
+                    rows_.push_back(f);
+                }
+            }
+        }
+    }
+
+    //the transformer gradient, split by columns
+    const float scale = 1.0f / static_cast<float>(n);
+    parallel_for(threads_, HALF, [&](int, const size_t first, const size_t last) {
+        for (size_t i = 0; i < n; ++i) {
+            for (int p = 0; p < 2; ++p) {
+                const float *d = &dacc_[i * L1 + p * HALF];
+                for (int k = 0; k < samples_[i].n; ++k) {
+                    float *g = &ft_grad_[static_cast<size_t>(samples_[i].features[p][k]) * HALF];
+                    for (size_t c = first; c < last; ++c)
+                        g[c] += d[c] * scale;
+                }
+            }
+        }
+    });
+
+    Gradients sum;
+    for (const Gradients &g: grads_) {
+        auto add = [scale](std::vector<float> &to, const std::vector<float> &from) {
+            for (size_t i = 0; i < to.size(); ++i)
+                to[i] += from[i] * scale;
+        };
+        add(sum.ft_b, g.ft_b);
+        add(sum.l1_w, g.l1_w);
+        add(sum.l1_b, g.l1_b);
+        add(sum.l2_w, g.l2_w);
+        add(sum.l2_b, g.l2_b);
+        add(sum.out_w, g.out_w);
+        add(sum.out_b, g.out_b);
+    }
+
+    ++step_;
+    adam(net_.l1, sum.l1_w, sum.l1_b, HIDDEN_MAX);
+    adam(net_.l2, sum.l2_w, sum.l2_b, HIDDEN_MAX);
+    adam(net_.out, sum.out_w, sum.out_b, OUT_MAX);
+
+    //the seen transformer rows, their gradient is cleared on the way
+    const float c1 = 1 - std::pow(BETA1, static_cast<float>(step_));
+    const float c2 = 1 - std::pow(BETA2, static_cast<float>(step_));
+    const float rate = static_cast<float>(cfg_.rate);
+    Layer &ft = net_.ft;
+    parallel_for(threads_, rows_.size(), [&](int, const size_t first, const size_t last) {
+        for (size_t r = first; r < last; ++r) {
+            const size_t row = static_cast<size_t>(rows_[r]) * HALF;
+            float *w = &ft.w[row], *m = &ft.mw[row], *v = &ft.vw[row], *g = &ft_grad_[row];
+            for (int i = 0; i < HALF; ++i) {
+                m[i] = BETA1 * m[i] + (1 - BETA1) * g[i];
+                v[i] = BETA2 * v[i] + (1 - BETA2) * g[i] * g[i];
+                w[i] -= rate * (m[i] / c1) / (std::sqrt(v[i] / c2) + EPSILON);
+                g[i] = 0;
+            }
+            touched_[rows_[r]] = 0;
+        }
+    });
+    adam(ft, {}, sum.ft_b, 32767 / FT_Q);
+
+    double loss = 0;
+    for (const double l: losses)
+        loss += l;
+    return loss;
+}
+
+double Trainer::epoch(std::mt19937_64 &rng) {
+    std::vector<uint32_t> order(data_.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), rng);
+
+    double loss = 0;
+    for (size_t i = 0; i < order.size(); i += samples_.size())
+        loss += batch(&order[i], std::min(samples_.size(), order.size() - i));
+    return loss / static_cast<double>(order.size());
+}
+
+template<typename T>
+void put(std::ostream &os, const T v) {
+    os.write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+template<typename T>
+T get(const uint8_t *&d) {
+    T v;
+    memcpy(&v, d, sizeof(T));
+    d += sizeof(T);
+    return v;
+}
+
+template<typename T>
+T quantise(const float v, const float q) {
+    const long r = std::lround(v * q);
+    return static_cast<T>(std::clamp<long>(r, std::numeric_limits<T>::min(),
+        std::numeric_limits<T>::max()));
+}
+
+bool Trainer::save(const std::string &path) const {
+    std::ofstream os(path, std::ios::binary);
+    if (!os)
+        return false;
+
+    std::string description = "Features=HalfKP(Friend)[41024->256x2],"
+        "Network=AffineTransform[1<-32](ClippedReLU[32](AffineTransform[32<-32]"
+        "(ClippedReLU[32](AffineTransform[32<-512](InputSlice[512(0:512)])))))";
+    description.resize(DESCRIPTION_SIZE, ' ');
+    put(os, VERSION);
+    put(os, NET_HASH);
+    put(os, static_cast<uint32_t>(DESCRIPTION_SIZE));
+    os.write(description.data(), DESCRIPTION_SIZE);
+
+    put(os, FT_HASH);
+    for (const float b: net_.ft.b)
+        put(os, quantise<int16_t>(b, FT_Q));
+    for (const float w: net_.ft.w)
+        put(os, quantise<int16_t>(w, FT_Q));
+
+    put(os, NETWORK_HASH);
+    for (const Layer *l: { &net_.l1, &net_.l2 }) {
+        for (const float b: l->b)
+            put(os, quantise<int32_t>(b, FT_Q * HIDDEN_Q) + HIDDEN_ROUND);
+        for (const float w: l->w)
+            put(os, quantise<int8_t>(w, HIDDEN_Q));
+    }
+    put(os, quantise<int32_t>(net_.out.b[0], EVAL_SCALE * 16));
+    for (const float w: net_.out.w)
+        put(os, quantise<int8_t>(w, OUT_Q));
+    return static_cast<bool>(os);
+}
+
+bool Trainer::load(const std::string &path) {
+    MappedFile f;
+    if (!f.open(path) || f.size() != FILE_SIZE)
+        return false;
+
+    const uint8_t *d = f.data();
+    if (get<uint32_t>(d) != VERSION || get<uint32_t>(d) != NET_HASH
+            || get<uint32_t>(d) != DESCRIPTION_SIZE)
+        return false;
+    d += DESCRIPTION_SIZE;
+    if (get<uint32_t>(d) != FT_HASH)
+        return false;
+    for (float &b: net_.ft.b)
+        b = get<int16_t>(d) / FT_Q;
+    for (float &w: net_.ft.w)
+        w = get<int16_t>(d) / FT_Q;
+
+    if (get<uint32_t>(d) != NETWORK_HASH)
+        return false;
+    for (Layer *l: { &net_.l1, &net_.l2 }) {
+        for (float &b: l->b)
+            b = static_cast<float>(get<int32_t>(d) - HIDDEN_ROUND) / (FT_Q * HIDDEN_Q);
+        for (float &w: l->w)
+            w = get<int8_t>(d) / HIDDEN_Q;
+    }
+    net_.out.b[0] = static_cast<float>(get<int32_t>(d)) / (EVAL_SCALE * 16);
+    for (float &w: net_.out.w)
+        w = get<int8_t>(d) / OUT_Q;
+    return true;
+}
+
+} //namespace
+
+void train(const std::string &data, const std::string &out, const TrainConfig &cfg) {
+    PackedReader reader;
+    if (!reader.open(data)) {
+        sync_cout() << "info string train: no positions in " << data << '\n';
+        return;
+    }
+
+    const uint64_t seed = std::random_device{}();
+    auto trainer = std::make_unique<Trainer>(reader, cfg);
+    if (cfg.init.empty()) {
+        trainer->randomize(seed);
+    } else if (!trainer->load(cfg.init)) {
+        sync_cout() << "info string train: cannot load " << cfg.init << '\n';
+        return;
+    }
+
+    const TimePoint start = timer::now();
+    std::mt19937_64 rng(seed);
+    double loss = 0;
+    for (int e = 1; e <= cfg.epochs; ++e) {
+        loss = trainer->epoch(rng);
+        const TimePoint elapsed = timer::now() - start;
+        if (!trainer->save(out)) {
+            sync_cout() << "info string train: cannot write " << out << '\n';
+            return;
+        }
+        sync_cout() << "info string train epoch " << e << " loss " << loss
+            << " pps " << reader.size() * e * 1000 / (elapsed + 1) << '\n';
+    }
+
+    std::ostringstream ss;
+    ss << "\nPositions: " << reader.size()
+       << "\nEpochs: " << cfg.epochs
+       << "\nLoss: " << loss
+       << "\nTime (ms): " << timer::now() - start << '\n';
+    sync_cout() << ss.str();
+}
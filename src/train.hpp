@@ -0,0 +1,26 @@
+#ifndef TRAIN_HPP
+#define TRAIN_HPP
+
+#include <string>
+
+struct TrainConfig {
+    int epochs = 10;
+    int batch = 16384;
+    int threads = 1;
+    //Adam step size
+    double rate = 0.001;
+    //weight of the search score against the game result in the target
+    double lambda = 0.75;
+    //a network to start from, random weights if empty
+    std::string init;
+};
+
+/*
+ * Trains a halfkp_256x2-32-32 network, the architecture the engine loads,
+ * on a packed position file with mini-batch Adam on `threads` threads.
+ * After every epoch the quantised network is written to `out` in the
+ * layout nnue_init() reads.
+ * */
+void train(const std::string &data, const std::string &out, const TrainConfig &cfg);
+
+#endif
@@ -1,8 +1,34 @@
 #include "tree.hpp"
+#include <fstream>
 #include <ostream>
 #include "primitives/utility.hpp"
+#include <algorithm>
+
+namespace {
+
+/*
+ * Dump layout, little-endian:
+ * "STRE" u32 version u64 count, then count nodes of 15 bytes:
+ * u16 move, i16 alpha, beta, score, u8 depth, ply, type, u32 subtree size
+ * */
+constexpr char DUMP_MAGIC[4] = { 'S', 'T', 'R', 'E' };
+constexpr uint32_t DUMP_VERSION = 1;
+
+template<typename T>
+void put(std::ostream &os, T v) {
+    for (size_t i = 0; i < sizeof(T); ++i)
+        os.put(static_cast<char>(static_cast<uint64_t>(v) >> (8 * i)));
+}
+
+template<typename T>
+T get(std::istream &is) {
+    uint64_t v = 0;
+    for (size_t i = 0; i < sizeof(T); ++i)
+        v |= static_cast<uint64_t>(static_cast<uint8_t>(is.get())) << (8 * i);
+    return static_cast<T>(v);
+}
 
-Tree g_tree;
+} //namespace
 
 std::ostream& operator<<(std::ostream& os, const Node &n) {
     for (uint8_t i = 0; i < n.ply; ++i)
@@ -16,44 +42,26 @@ std::ostream& operator<<(std::ostream& os, const Node &n) {
     return os;
 }
 
-void Tree::clear() { nodes.clear(); }
-
-size_t Tree::begin_node(Move prev, int16_t alpha, int16_t beta, 
-        uint8_t depth, uint8_t ply, NodeType nt)
-{
-#ifdef TRACE
-    nodes.push_back(Node{ prev, alpha, beta, 0, depth, 
-            ply, nt, 0 });
-    return size() - 1;
-#else
-    (void)(prev);
-    (void)(alpha);
-    (void)(beta);
-    (void)(depth);
-    (void)(ply);
-    (void)(nt);
-    return 0;
-#endif
+void Tree::clear() { 
+    nodes.clear(); 
+    dropped_ = 0;
 }
 
-void Tree::end_node(size_t node_idx, int16_t score) {
-#ifdef TRACE
-    nodes[node_idx].subtree_size = static_cast<uint32_t>(
-        size() - (node_idx + 1)
-    );
-    nodes[node_idx].score = score;
-#else
-    (void)(node_idx);
-    (void)(score);
-#endif
+void Tree::set_capacity(const size_t num_nodes) {
+    capacity_ = num_nodes;
+    nodes.clear();
+    nodes.shrink_to_fit();
+    nodes.reserve(capacity_);
+    dropped_ = 0;
 }
 
-void Tree::set_last_type(NodeType ntp) {
-#ifdef TRACE
-    nodes.back().ntp = ntp;
-#else
-    (void)(ntp);
-#endif
+size_t Tree::capacity() const { return capacity_; }
+
+uint64_t Tree::dropped() const { return dropped_; }
+
+void Tree::set_last_type(const NodeType ntp) {
+    if (!nodes.empty())
+        nodes.back().ntp = ntp;
 }
 
 size_t Tree::size() const { return nodes.size(); }
@@ -162,3 +170,61 @@ void Tree::json(std::ostream &os, const size_t parent) const {
     os << "]}";
 }
 
+
+bool Tree::save(const std::string &path) const {
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+        return false;
+
+    out.write(DUMP_MAGIC, sizeof(DUMP_MAGIC));
+    put<uint32_t>(out, DUMP_VERSION);
+    put<uint64_t>(out, nodes.size());
+    for (const Node &n: nodes) {
+        put<uint16_t>(out, n.played);
+        put<int16_t>(out, n.alpha);
+        put<int16_t>(out, n.beta);
+        put<int16_t>(out, n.score);
+        put<uint8_t>(out, n.depth);
+        put<uint8_t>(out, n.ply);
+        put<uint8_t>(out, static_cast<uint8_t>(n.ntp));
+        put<uint32_t>(out, n.subtree_size);
+    }
+
+    return static_cast<bool>(out);
+}
+
+bool Tree::load(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[4]{};
+    if (!in.read(magic, sizeof(magic)) 
+            || !std::equal(magic, magic + 4, DUMP_MAGIC)
+            || get<uint32_t>(in) != DUMP_VERSION)
+        return false;
+
+    const auto count = get<uint64_t>(in);
+    std::vector<Node> loaded;
+    for (uint64_t i = 0; i < count && in; ++i) {
+        Node n{};
+        n.played = get<Move>(in);
+        n.alpha = get<int16_t>(in);
+        n.beta = get<int16_t>(in);
+        n.score = get<int16_t>(in);
+        n.depth = get<uint8_t>(in);
+        n.ply = get<uint8_t>(in);
+        n.ntp = static_cast<NodeType>(get<uint8_t>(in));
+        n.subtree_size = get<uint32_t>(in);
+        loaded.push_back(n);
+    }
+
+    if (!in)
+        return false;
+
+    //subtrees must not run past the end
+    for (size_t i = 0; i < loaded.size(); ++i)
+        if (loaded[i].subtree_size >= loaded.size() - i)
+            return false;
+
+    nodes = std::move(loaded);
+    dropped_ = 0;
+    return true;
+}
@@ -1,12 +1,11 @@
 #ifndef TREE_HPP
 #define TREE_HPP
 
-//#define TRACE
-
 #include "primitives/common.hpp"
 #include <vector>
 #include <iosfwd>
 #include <limits>
+#include <string>
 
 enum class NodeType : uint8_t {
     NonTerminal,
@@ -44,19 +43,27 @@ struct Node {
  *      (n), [(n.1), ..., (n.ss)]]
  * */
 struct Tree {
-    //maybe deque?
     std::vector<Node> nodes;
     static constexpr size_t npos = 
         std::numeric_limits<size_t>::max();
 
     void clear();
 
-    static size_t begin_node(Move prev, int16_t alpha, int16_t beta, 
-                             uint8_t depth, uint8_t ply, NodeType nt = NodeType::NonTerminal);
+    /*
+     * Recording is off until a capacity is set. The buffer never grows
+     * past it: once full, new nodes are dropped, so the stored nodes
+     * stay a valid (truncated) DFS layout.
+     * */
+    void set_capacity(size_t num_nodes);
+    [[nodiscard]] size_t capacity() const;
+    [[nodiscard]] uint64_t dropped() const;
+
+    size_t begin_node(Move prev, int16_t alpha, int16_t beta, 
+                      uint8_t depth, uint8_t ply, NodeType nt = NodeType::NonTerminal);
 
-    static void end_node(size_t node_idx, int16_t score);
+    void end_node(size_t node_idx, int16_t score);
 
-    static void set_last_type(NodeType ntp);
+    void set_last_type(NodeType ntp);
 
     [[nodiscard]] size_t size() const;
 
@@ -73,9 +80,39 @@ struct Tree {
 
     void json(std::ostream &os) const;
     void json(std::ostream &os, size_t parent) const;
+
+    //binary dump, see tree.cpp for the layout
+    [[nodiscard]] bool save(const std::string &path) const;
+    [[nodiscard]] bool load(const std::string &path);
+
+private:
+    size_t capacity_{};
+    uint64_t dropped_{};
 };
 
-extern Tree g_tree;
+inline size_t Tree::begin_node(const Move prev, const int16_t alpha, 
+        const int16_t beta, const uint8_t depth, const uint8_t ply,
+        const NodeType nt)
+{
+    if (nodes.size() >= capacity_) {
+        dropped_ += capacity_ != 0;
+        return npos;
+    }
+
+    nodes.push_back(Node{ prev, alpha, beta, 0, depth, 
+            ply, nt, 0 });
+    return nodes.size() - 1;
+}
+
+inline void Tree::end_node(const size_t node_idx, const int16_t score) {
+    if (node_idx == npos)
+        return;
+
+    nodes[node_idx].subtree_size = static_cast<uint32_t>(
+        nodes.size() - (node_idx + 1)
+    );
+    nodes[node_idx].score = score;
+}
 
 std::ostream& operator<<(std::ostream& os, const Node &n);
 
@@ -0,0 +1,279 @@
+#include "tune.hpp"
+#include "board/board.hpp"
+#include "board/packed.hpp"
+#include "core/eval.hpp"
+#include "core/search_common.hpp"
+#include "primitives/parallel.hpp"
+#include "cli.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+/*
+ * FILE: tune.cpp
+ * The eval is linear in the tables: with phase p in [0, 1]
+ *     eval = p * sum(c_i * mg_i) + (1 - p) * sum(c_i * eg_i),
+ * where c_i counts white minus black pieces on table entry i. Positions
+ * are stored as structure of arrays: their sparse (index, count) lists
+ * back to back, and phase, target and eval as plain float arrays, so
+ * the sigmoid and error pass runs over contiguous floats and
+ * vectorizes. Each thread takes a slice of the positions and sums its
+ * own gradient, the slices are added up after every pass.
+ * */
+
+namespace {
+
+constexpr int TABLE_SIZE = PIECE_TYPE_NB * SQUARE_NB;
+constexpr int PARAMS = 2 * TABLE_SIZE; //mg, then eg
+constexpr double BETA1 = 0.9, BETA2 = 0.999, EPSILON = 1e-8;
+constexpr int REPORT_EPOCHS = 10;
+
+struct Dataset {
+    std::vector<uint32_t> begin{0}; //of each position's features, size n + 1
+    std::vector<uint16_t> index;
+    std::vector<int8_t> count;
+    std::vector<float> phase, target, score; //score is from white's side
+
+    [[nodiscard]] size_t size() const { return phase.size(); }
+
+    void add(const Board &b, const int score_white, const int result_white) {
+        int game_phase = 0;
+        for (const PieceType pt: ALL_PTYPES) {
+            for (Color c: { WHITE, BLACK }) {
+                Bitboard bb = b.pieces(c, pt);
+                while (bb) {
+                    const Square sq = pop_lsb(bb);
+                    index.push_back(static_cast<uint16_t>(pt * SQUARE_NB 
+                        + (c == WHITE ? sq ^ 56 : sq)));
+                    count.push_back(c == WHITE ? 1 : -1);
+                    game_phase += gamephaseInc[pt];
+                }
+            }
+        }
+        begin.push_back(static_cast<uint32_t>(index.size()));
+        phase.push_back(std::min(game_phase, 24) / 24.0f);
+        target.push_back((result_white + 1) / 2.0f);
+        score.push_back(static_cast<float>(score_white));
+    }
+};
+
+class Tuner {
+public:
+    Tuner(const Dataset &data, const TuneConfig &cfg);
+
+    //fits K to the results with the current weights, golden section search
+    void fit_k();
+    //one Adam step on the full batch, returns the loss before it
+    double step();
+    [[nodiscard]] double loss();
+
+    [[nodiscard]] double k() const { return k_; }
+    [[nodiscard]] const std::vector<double> &weights() const { return w_; }
+
+private:
+    //the mean error of [first, last), and its gradient if grad is set
+    double pass(size_t first, size_t last, std::vector<float> &evals, double *grad) const;
+    double run(std::vector<double> *grad);
+
+    const Dataset &data_;
+    const TuneConfig &cfg_;
+    const int threads_;
+    std::vector<double> w_, m_, v_;
+    std::vector<float> targets_;
+    std::vector<std::vector<float>> evals_;
+    std::vector<std::vector<double>> grads_;
+    double k_ = std::log(10.0) / 400;
+    int t_{};
+};
+
+Tuner::Tuner(const Dataset &data, const TuneConfig &cfg)
+    : data_(data), cfg_(cfg), threads_(std::max(cfg.threads, 1)),
+      w_(PARAMS), m_(PARAMS), v_(PARAMS), targets_(data.target),
+      evals_(threads_), grads_(threads_, std::vector<double>(PARAMS))
+{
+    for (const PieceType pt: ALL_PTYPES) {
+        for (Square sq = SQ_A1; sq <= SQ_H8; ++sq) {
+            w_[pt * SQUARE_NB + sq] = mg_pst(pt, sq);
+            w_[TABLE_SIZE + pt * SQUARE_NB + sq] = eg_pst(pt, sq);
+        }
+    }
+}
+
+double Tuner::pass(const size_t first, const size_t last,
+        std::vector<float> &evals, double *grad) const
+{
+    const size_t n = last - first;
+    evals.resize(n);
+
+    //gather: the linear eval of every position
+    for (size_t i = 0; i < n; ++i) {
+        double mg = 0, eg = 0;
+        for (uint32_t j = data_.begin[first + i]; j < data_.begin[first + i + 1]; ++j) {
+            mg += w_[data_.index[j]] * data_.count[j];
+            eg += w_[TABLE_SIZE + data_.index[j]] * data_.count[j];
+        }
+        const float p = data_.phase[first + i];
+        evals[i] = static_cast<float>(mg * p + eg * (1 - p));
+    }
+
+    //sigmoid and error, over contiguous arrays. evals turns into
+    //the derivative of the error with respect to the eval
+    const float k = static_cast<float>(k_);
+    const float *target = targets_.data() + first;
+    double error = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const float s = 1 / (1 + std::exp(-k * evals[i]));
+        const float d = s - target[i];
+        error += d * d;
+        evals[i] = 2 * d * s * (1 - s) * k;
+    }
+
+    //scatter: the gradient of the tables
+    if (grad) {
+        for (size_t i = 0; i < n; ++i) {
+            const double p = data_.phase[first + i];
+            for (uint32_t j = data_.begin[first + i]; j < data_.begin[first + i + 1]; ++j) {
+                const double g = evals[i] * data_.count[j];
+                grad[data_.index[j]] += g * p;
+                grad[TABLE_SIZE + data_.index[j]] += g * (1 - p);
+            }
+        }
+    }
+    return error;
+}
+
+double Tuner::run(std::vector<double> *grad) {
+    std::vector<double> errors(threads_);
+    parallel_for(threads_, data_.size(), [&](const int t, const size_t first, const size_t last) {
+        if (grad)
+            std::fill(grads_[t].begin(), grads_[t].end(), 0);
+        errors[t] = pass(first, last, evals_[t], grad ? grads_[t].data() : nullptr);
+    });
+
+    if (grad) {
+        std::fill(grad->begin(), grad->end(), 0);
+        for (auto &g: grads_)
+            for (int i = 0; i < PARAMS; ++i)
+                (*grad)[i] += g[i] / static_cast<double>(data_.size());
+    }
+    double error = 0;
+    for (const double e: errors)
+        error += e;
+    return error / static_cast<double>(data_.size());
+}
+
+double Tuner::loss() {
+    return run(nullptr);
+}
+
+void Tuner::fit_k() {
+    const double ratio = (std::sqrt(5.0) - 1) / 2;
+    double lo = 0.0001, hi = 0.05;
+    for (int i = 0; i < 40; ++i) {
+        const double a = hi - ratio * (hi - lo), b = lo + ratio * (hi - lo);
+        k_ = a;
+        const double loss_a = loss();
+        k_ = b;
+        if (loss_a < loss())
+            hi = b;
+        else
+            lo = a;
+    }
+    k_ = (lo + hi) / 2;
+
+    //blends in the search score once K is known
+    for (size_t i = 0; i < data_.size(); ++i)
+        targets_[i] = static_cast<float>((1 - cfg_.lambda) * data_.target[i]
+            + cfg_.lambda / (1 + std::exp(-k_ * data_.score[i])));
+}
+
+double Tuner::step() {
+    std::vector<double> grad(PARAMS);
+    const double error = run(&grad);
+
+    ++t_;
+    const double c1 = 1 - std::pow(BETA1, t_), c2 = 1 - std::pow(BETA2, t_);
+    for (int i = 0; i < PARAMS; ++i) {
+        m_[i] = BETA1 * m_[i] + (1 - BETA1) * grad[i];
+        v_[i] = BETA2 * v_[i] + (1 - BETA2) * grad[i] * grad[i];
+        w_[i] -= cfg_.rate * (m_[i] / c1) / (std::sqrt(v_[i] / c2) + EPSILON);
+    }
+    return error;
+}
+
+bool load(const std::string &path, Dataset &data) {
+    PackedReader reader;
+    if (!reader.open(path))
+        return false;
+    Board b;
+    for (const PackedBoard &pb: reader) {
+        if (!b.load_packed(pb))
+            continue;
+        const int sign = pb.stm == WHITE ? 1 : -1;
+        data.add(b, sign * pb.score, sign * pb.result);
+    }
+    return data.size() > 0;
+}
+
+void write_tables(std::ostream &os, const std::vector<double> &w) {
+    static const char *names[PIECE_TYPE_NB] = {
+        nullptr, "pawn", "knight", "bishop", "rook", "queen", "king"
+    };
+    for (const PieceType pt: ALL_PTYPES) {
+        for (int phase = 0; phase < 2; ++phase) {
+            const int material = phase ? eg_value[pt] : mg_value[pt];
+            os << "constexpr int16_t " << (phase ? "eg_" : "mg_") << names[pt]
+               << "_table[64] = {\n";
+            for (int sq = 0; sq < SQUARE_NB; ++sq) {
+                const double v = w[phase * TABLE_SIZE + pt * SQUARE_NB + sq];
+                os << (sq % 8 ? " " : "    ") << std::setw(4)
+                   << std::lround(v - material) << ',' << (sq % 8 == 7 ? "\n" : "");
+            }
+            os << "};\n\n";
+        }
+    }
+}
+
+} //namespace
+
+void tune(const std::string &path, const std::string &out, const TuneConfig &cfg) {
+    const TimePoint start = timer::now();
+    Dataset data;
+    if (!load(path, data)) {
+        sync_cout() << "info string tune: no positions in " << path << '\n';
+        return;
+    }
+
+    Tuner tuner(data, cfg);
+    tuner.fit_k();
+    const double initial = tuner.loss();
+    sync_cout() << "info string tune positions " << data.size()
+        << " k " << tuner.k() << " loss " << initial << '\n';
+
+    double error = initial;
+    for (int epoch = 1; epoch <= cfg.epochs; ++epoch) {
+        error = tuner.step();
+        if (epoch % REPORT_EPOCHS == 0)
+            sync_cout() << "info string tune epoch " << epoch << " loss " << error << '\n';
+    }
+    error = tuner.loss();
+
+    std::ofstream f(out);
+    if (!f) {
+        sync_cout() << "info string tune: cannot open " << out << '\n';
+        return;
+    }
+    f << "//tuned on " << data.size() << " positions, K " << tuner.k()
+      << ", loss " << initial << " -> " << error << "\n\n";
+    write_tables(f, tuner.weights());
+
+    std::ostringstream ss;
+    ss << "\nPositions: " << data.size()
+       << "\nEpochs: " << cfg.epochs
+       << "\nLoss: " << initial << " -> " << error
+       << "\nTime (ms): " << timer::now() - start << '\n';
+    sync_cout() << ss.str();
+}
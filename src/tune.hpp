@@ -0,0 +1,24 @@
+#ifndef TUNE_HPP
+#define TUNE_HPP
+
+#include <string>
+
+struct TuneConfig {
+    int epochs = 300;
+    int threads = 1;
+    //Adam step size, in centipawns
+    double rate = 1.0;
+    //weight of the search score against the game result in the target
+    double lambda = 0;
+};
+
+/*
+ * Texel tuning of the PeSTO piece-square tables (material included)
+ * on a packed position file: full-batch Adam on the mean squared error
+ * between sigmoid(K * eval) and the game result, where K is fitted to
+ * the initial tables first. Writes the tables to `out` in the layout
+ * of core/eval.cpp, with the material values taken out again.
+ * */
+void tune(const std::string &path, const std::string &out, const TuneConfig &cfg);
+
+#endif